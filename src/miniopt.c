@@ -11,7 +11,43 @@
  * @brief miniopt library implementation.
  */
 
+#ifdef USING_MINIOPT_MMAP
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE     // For MAP_ANONYMOUS.
+#endif
+#endif
+
 #include "miniopt.h"
+#include <stdint.h>
+
+#ifdef USING_MINIOPT_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// The default allocator of specs and contexts, see miniopt_heap_alloc_fn.
+#ifdef USING_MINIOPT_HEAP
+#include <stdlib.h>
+#define MINIOPT_DEFAULT_ALLOC miniopt_heap_alloc_fn
+#else
+#define MINIOPT_DEFAULT_ALLOC nil
+#endif
+
+// The smallest long name hash index, see miniopt_alloc_long_index().
+#define LONG_INDEX_MIN_SIZE 16
+
+#ifdef USING_MINIOPT_SIMD
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MINIOPT_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || \
+      (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MINIOPT_SSE2
+#endif
+#endif
 
 //#define DEBUG
 #ifdef DEBUG
@@ -33,36 +69,55 @@ enum option_context_state {
 };
 
 /**
- * @brief option_context.
+ * @brief Token char class.
  */
-typedef struct option_context_ {
-    int argc;               ///< Command line arg size.
-    char **argv;            ///< Command line args.
-
-    option *opts;           ///< Option array.
-    int optsum;             ///< Option array size.
+enum token_char_class {
+    char_nul = 0,               ///< String terminator '\0'.
+    char_dash,                  ///< Char '-'.
+    char_equal,                 ///< Char '='.
+    char_other,                 ///< Any other char.
+    char_class_sum
+};
 
-    int optind;             ///< Current option index;
-    const char *optarg;     ///< Current option-arg or non-option-arg.
-    const char *error;      ///< Current error message;
+/**
+ * @brief Token DFA state or action.
+ * 
+ * The states walk the token prefix("", "-", "--"), then every path ends at
+ * an action decides what the token is.
+ */
+enum token_dfa {
+    token_begin = 0,            ///< State, nothing is read.
+    token_dash,                 ///< State, "-" is read.
+    token_dash_dash,            ///< State, "--" is read.
+    token_state_sum,
+    action_empty = token_state_sum, ///< Empty token, skip it.
+    action_non_opt,             ///< Non-option-argument.
+    action_short_opt,           ///< Short option like "-x...".
+    action_long_opt,            ///< Long option like "--key...".
+    action_marker,              ///< Non-option-argument marker "--".
+    action_unknown              ///< Unknown option.
+};
 
-    int index;              ///< Current parsing index to argv.
-    const char *token;      ///< Current parsing token.
-    const char *it;         ///< Forward iterator to the parsing token.
-    int state;              ///< Current parsing state.
-} option_context;
+/**
+ * @brief Token DFA transition table, [state][char class] to state or action.
+ */
+static const unsigned char token_dfa_table[token_state_sum][char_class_sum] = {
+    //  char_nul        char_dash         char_equal       char_other
+    {action_empty,   token_dash,       action_non_opt,  action_non_opt},
+    {action_unknown, token_dash_dash,  action_unknown,  action_short_opt},
+    {action_marker,  action_long_opt,  action_long_opt, action_long_opt}
+};
 
-static option_context optctx;   // Global option context.
 
 /**
  * @brief Convert number to decimal number string.
  * 
+ * @param[out] buf          Destination buf, 32 bytes is enough for any int.
+ * @param[in] bufsize       Destination buf size.
  * @param[in] number        A number to convert.
- * @return const char*      Decimal number string.
+ * @return const char*      Decimal number string(it is the buf).
  */
-const char *miniopt_to_string(int number) {
-    static char buf[32];
-    static const int bufsize = sizeof(buf) / sizeof(buf[0]);
+const char *miniopt_to_string(char *buf, int bufsize, int number) {
     static const char dict[] = "0123456789";
 
     buf[bufsize - 1] = '\0';
@@ -125,70 +180,310 @@ int miniopt_concat(char *buf, int bufsz, const char *s1, const char *s2,
 }
 
 /**
- * @brief Make an error string.
+ * @brief Make an error.
  * 
- * It will change parsing state to error state.
+ * It will change parsing state to error state, the message is not formatted
+ * until miniopt_ctx_what() is called.
  * 
- * @param[in] s1    Input string1
- * @param[in] s2    Input string2
- * @param[in] s3    Input string3
+ * @param[in] ctx       Option context.
+ * @param[in] code      Error code.
+ * @param[in] argind    Argv index of the token.
+ * @param[in] optind    Option index, optsum if not an option.
+ * @param[in] token     The token, it can be nil.
  */
-void miniopt_make_error(const char *s1, const char *s2, const char *s3) {
-    static char error[ERROR_STR_MAX_SIZE];
+void miniopt_make_error(option_context *ctx, option_errc code, int argind,
+                        int optind, const char *token) {
+    ctx->err.code = code;
+    ctx->err.argind = argind;
+    ctx->err.optind = optind;
+    ctx->err.other = -1;
+    ctx->err.file = nil;
+    ctx->err.line = 0;
+    ctx->err.token = token;
+    ctx->error = nil;
+    ctx->state = state_error;
+}
 
-    miniopt_assert(!(s1 == nil && s2 == nil && s3 == nil));
+/**
+ * @brief Make an option array error string.
+ * 
+ * @param[in] spec      Option spec.
+ * @param[in] optind    Option index to the option array.
+ * @param[in] s         Input string.
+ */
+void miniopt_make_spec_error(option_spec *spec, int optind, const char *s) {
+    char buf[32];
+    miniopt_concat(spec->errbuf, ERROR_STR_MAX_SIZE, "Option index = ",
+                   miniopt_to_string(buf, sizeof(buf), optind), s);
+    spec->error = spec->errbuf;
+}
 
-    if (s1 == nil && s2 == nil && s3 == nil) {
-        error[0] = '\0';
-    } else {
-        miniopt_concat(error, ERROR_STR_MAX_SIZE, s1, s2, s3);
+/**
+ * @brief Make a duplicate name error string.
+ * 
+ * @param[in] spec      Option spec.
+ * @param[in] optind    Option index to the option array.
+ * @param[in] first     Option index uses the name first.
+ * @param[in] s         Input string, it ends with "option index = ".
+ */
+void miniopt_make_dup_error(option_spec *spec, int optind, int first,
+                            const char *s) {
+    char buf[32];
+    char msg[ERROR_STR_MAX_SIZE];
+    miniopt_concat(msg, sizeof(msg), s,
+                   miniopt_to_string(buf, sizeof(buf), first), ".");
+    miniopt_make_spec_error(spec, optind, msg);
+}
+
+/**
+ * @brief Read next token from the argument array.
+ * 
+ * @param[in] ctx    Option context.
+ * 
+ * @return option_view      Next token, its size is -1(unknown). The data
+ *                          is nil if no more token to read.
+ */
+option_view miniopt_read_argv(option_context *ctx) {
+    miniopt_assert(ctx->argc > 0);
+    miniopt_assert(ctx->argv != nil);
+
+    option_view view = {nil, -1};
+    if (ctx->argc <= 1) { // Only one arg is the file path, skip it.
+        return view;
+    } else if (ctx->index == -1) { // It is first time to get token.
+        ctx->index = 1;
+        view.data = ctx->argv[ctx->index];
+    } else if (++ctx->index < ctx->argc) { // Not first time.
+        view.data = ctx->argv[ctx->index];
+    }
+    return view;
+}
+
+/**
+ * @brief Read next token from the token source.
+ * 
+ * @param[in] ctx    Option context.
+ * 
+ * @return option_view      Next token. The data is nil if no more token to
+ *                          read or error.
+ */
+option_view miniopt_read_source(option_context *ctx) {
+    option_view view;
+    int status = ctx->source(ctx->user, &view);
+    if (status > 0) {
+        ++ctx->index;
+        return view;
+    }
+    if (status < 0) {
+        miniopt_make_error(ctx, MINIOPT_ERR_READ, ctx->index + 1,
+                           ctx->spec->optsum, nil);
+    }
+    view.data = nil;
+    view.size = 0;
+    return view;
+}
+
+/**
+ * @brief Read next token from the token source or the argument array.
+ */
+option_view miniopt_read_input(option_context *ctx) {
+    return ctx->source ? miniopt_read_source(ctx) : miniopt_read_argv(ctx);
+}
+
+#ifdef USING_MINIOPT_MMAP
+/**
+ * @brief Map a file into memory, the memory is private and writable.
+ * 
+ * There is at least one zero byte after the file data, so the last token
+ * can be terminated in place.
+ * 
+ * @param[in] path      File path.
+ * @param[out] map      Output mapping.
+ * 
+ * @return 0            Pass.
+ * @return -1           Fail.
+ */
+int miniopt_map_file(const char *path, option_map *map) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    size_t size = (size_t)st.st_size;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t mapsize = (size / page + 1) * page;
+
+    // Reserve zero pages, then map the file over them.
+    char *data = (char *)mmap(nil, mapsize, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        return -1;
     }
+    if (size > 0 && mmap(data, size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(data, mapsize);
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    map->data = data;
+    map->size = size;
+    map->mapsize = mapsize;
+    return 0;
+}
+
+/**
+ * @brief Check whether a char is a token separator of response file.
+ */
+int miniopt_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' ||
+           c == '\f' || c == '\0';
+}
+
+/**
+ * @brief Read next token from the response file in place.
+ * 
+ * Tokens are separated by spaces, '"' or '\'' quotes a part of token, and
+ * '\\' escapes next char(except in '\'' quotes). The quotes and escapes
+ * are removed in place, then the token is terminated by '\0'.
+ * 
+ * @param[in] ctx       Option context.
+ * @param[out] view     Output token view into the mapping.
+ * 
+ * @return 1            Read pass.
+ * @return 0            No more token.
+ */
+int miniopt_read_rsp_token(option_context *ctx, option_view *view) {
+    char *it = ctx->rspIt;
+    char *end = ctx->rspEnd;
+
+    while (it < end && miniopt_is_space(*it)) { ++it; }
+    if (it >= end) {
+        ctx->rspIt = nil;
+        return 0;
+    }
+
+    char *out = it;
+    char quote = '\0';
+    view->data = out;
+    while (it < end) {
+        char c = *it++;
+        if (quote == '\0' && miniopt_is_space(c)) break;
+        if (c == quote) {
+            quote = '\0';
+            continue;
+        }
+        if (quote == '\0' && (c == '"' || c == '\'')) {
+            quote = c;
+            continue;
+        }
+        if (c == '\\' && quote != '\'' && it < end) c = *it++;
+        *out++ = c;
+    }
+    view->size = (int)(out - view->data);
+    *out = '\0';   // It is the separator or the zero byte after the file.
+
+    ctx->rspIt = it;
+    return 1;
+}
+
+/**
+ * @brief Start reading tokens from a response file.
+ * 
+ * @param[in] ctx       Option context.
+ * @param[in] token     The "@file" token.
+ * 
+ * @return 0            Pass.
+ * @return -1           Fail, the context is in error state.
+ */
+int miniopt_open_rsp(option_context *ctx, const char *token) {
+    if (ctx->mapsum >= RESPONSE_FILE_MAX_SIZE) {
+        miniopt_make_error(ctx, MINIOPT_ERR_RSP_TOO_MANY, ctx->index,
+                           ctx->spec->optsum, token);
+        return -1;
+    }
+
+    option_map *map = &ctx->maps[ctx->mapsum];
+    if (miniopt_map_file(token + 1, map) != 0) {
+        miniopt_make_error(ctx, MINIOPT_ERR_RSP_READ, ctx->index,
+                           ctx->spec->optsum, token);
+        return -1;
+    }
+
+    ++ctx->mapsum;
+    ctx->rspIt = map->data;
+    ctx->rspEnd = map->data + map->size;
+    return 0;
+}
+#endif
+
+/**
+ * @brief Read next token, "@file" is expanded if USING_MINIOPT_MMAP.
+ * 
+ * @param[in] ctx    Option context.
+ * 
+ * @return option_view      Next token, its size is -1 if unknown. The data
+ *                          is nil if no more token to read or error.
+ */
+option_view miniopt_read_token(option_context *ctx) {
+#ifdef USING_MINIOPT_MMAP
+    for (;;) {
+        option_view view;
+        if (ctx->rspIt != nil && miniopt_read_rsp_token(ctx, &view)) {
+            return view;
+        }
 
-    optctx.error = error;
-    optctx.state = state_error;
+        view = miniopt_read_input(ctx);
+        const char *token = view.data;
+        if (token == nil || token[0] != '@' || token[1] == '\0') {
+            return view;
+        }
+        if (miniopt_open_rsp(ctx, token) != 0) {
+            view.data = nil;
+            return view;
+        }
+    }
+#else
+    return miniopt_read_input(ctx);
+#endif
 }
 
 /**
  * @brief Peek next token.
  * 
+ * @param[in] ctx    Option context.
+ * 
  * @return NOT_nil     Next token.
  * @return nil         No more token exist. 
  */
-const char *miniopt_peek_next_token() {
-    miniopt_assert(optctx.argc > 0);
-    miniopt_assert(optctx.argv != nil);
-
-    if (optctx.argc <= 1) { // Only one arg is the file path, skip it.
-        return nil;
-    } else if (optctx.index == -1) { // It is first time to peek token.
-        return optctx.argv[1];
-    } else if ((optctx.index + 1) < optctx.argc) { // Not first time.
-        return optctx.argv[optctx.index + 1];
-    } else {
-        return nil; // No more tokens.
+const char *miniopt_peek_next_token(option_context *ctx) {
+    if (!ctx->peeked) {
+        ctx->peek = miniopt_read_token(ctx);
+        ctx->peeked = 1;
     }
+    return ctx->peek.data;
 }
 
 /**
  * @brief Get next token.
  * 
- * @return NOT_nil     Next token.
- * @return nil         No more token to get. 
+ * @param[in] ctx    Option context.
+ * 
+ * @return option_view      Next token, its size is -1 if unknown. The data
+ *                          is nil if no more token to get.
  */
-const char *miniopt_get_next_token() {
-    miniopt_assert(optctx.argc > 0);
-    miniopt_assert(optctx.argv != nil);
-
-    if (optctx.argc <= 1) { // Only one arg is the file path, skip it.
-        return nil;
-    } else if (optctx.index == -1) { // It is first time to get token.
-        optctx.index = 1;
-        return optctx.argv[optctx.index];
-    } else if (++optctx.index < optctx.argc) { // Not first time.
-        return optctx.argv[optctx.index];
-    } else {
-        return nil; // No more tokens.
+option_view miniopt_get_next_token(option_context *ctx) {
+    if (ctx->peeked) {
+        ctx->peeked = 0;
+        return ctx->peek;
     }
+    return miniopt_read_token(ctx);
 }
 
 /**
@@ -199,7 +494,7 @@ const char *miniopt_get_next_token() {
  * @return 0        It has no argument.
  * @return 1        It has an argument.
  */
-int miniopt_opt_has_arg(option* opt)
+int miniopt_opt_has_arg(const option* opt)
 {
     miniopt_assert(opt != nil);
 
@@ -209,6 +504,7 @@ int miniopt_opt_has_arg(option* opt)
 /**
  * @brief Check whether input char is short option.
  * 
+ * @param[in] spec      Option spec.
  * @param[in] c         Input char.
  * @param[out] hasArg   Whether this option need argument.
  * @param[out] optind   Option index to the option array.
@@ -216,23 +512,23 @@ int miniopt_opt_has_arg(option* opt)
  * @return 1            It is short option.
  * @return 0            It is not short option.
  */
-int miniopt_is_short_option(char c, int *hasArg, int *optind) {
+int miniopt_is_short_option(const option_spec *spec, char c, int *hasArg,
+                            int *optind) {
     miniopt_assert(hasArg != nil);
     miniopt_assert(optind != nil);
 
-    if (c == '-' || c == '=' || c == 0) return 0;
-
-    *hasArg = 0;
-    *optind = optctx.optsum;
-    for (int i = 0; i < optctx.optsum; ++i) {
-        if (optctx.opts[i].sname == c) {
-            *hasArg = miniopt_opt_has_arg(&(optctx.opts[i]));
-            *optind = i;
-            return 1;
-        }
+    // '-', '=' and '\0' are never put into the table, see miniopt_spec_init().
+    unsigned char uc = (unsigned char)c;
+    int i = spec->shortIndex[uc];
+    if (i < 0) {
+        *hasArg = 0;
+        *optind = spec->optsum;
+        return 0;
     }
 
-    return 0;
+    *hasArg = (spec->shortHasArg[uc >> 3] >> (uc & 7)) & 1;
+    *optind = i;
+    return 1;
 }
 
 /**
@@ -258,9 +554,75 @@ int miniopt_is_same(const char *beg, const char *end, const char *str) {
     return (beg == end && *str == '\0');
 }
 
+#ifdef USING_MINIOPT_SIMD
+/**
+ * @brief Copy a string into a zero padded name.
+ * 
+ * @param[out] name     Output name.
+ * @param[in] beg       Input string begin.
+ * @param[in] end       Input string end.
+ * 
+ * @return 1            Copy pass.
+ * @return 0            The string is longer than OPTION_NAME_MAX_SIZE.
+ */
+int miniopt_make_name(option_name *name, const char *beg, const char *end) {
+    if (end - beg > OPTION_NAME_MAX_SIZE) return 0;
+
+    for (int i = 0; i < OPTION_NAME_MAX_SIZE / 8; ++i) { name->u64[i] = 0; }
+    for (int i = 0; beg < end; ++i) { name->str[i] = *beg++; }
+
+    return 1;
+}
+
+/**
+ * @brief Compare two zero padded names.
+ * 
+ * @param[in] a     First name, it should be 32 bytes aligned.
+ * @param[in] b     Second name, it should be 32 bytes aligned.
+ * 
+ * @return 1        They are the same.
+ * @return 0        They are not the same.
+ */
+int miniopt_is_same_name(const option_name *a, const option_name *b) {
+#if defined(MINIOPT_AVX2)
+    __m256i x = _mm256_load_si256((const __m256i *)a->str);
+    __m256i y = _mm256_load_si256((const __m256i *)b->str);
+    return _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)) == -1;
+#elif defined(MINIOPT_SSE2)
+    __m128i x0 = _mm_load_si128((const __m128i *)a->str);
+    __m128i x1 = _mm_load_si128((const __m128i *)(a->str + 16));
+    __m128i y0 = _mm_load_si128((const __m128i *)b->str);
+    __m128i y1 = _mm_load_si128((const __m128i *)(b->str + 16));
+    __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(x0, y0), _mm_cmpeq_epi8(x1, y1));
+    return _mm_movemask_epi8(eq) == 0xFFFF;
+#else
+    return ((a->u64[0] ^ b->u64[0]) | (a->u64[1] ^ b->u64[1]) |
+            (a->u64[2] ^ b->u64[2]) | (a->u64[3] ^ b->u64[3])) == 0;
+#endif
+}
+#endif
+
+/**
+ * @brief Hash a string(FNV-1a).
+ * 
+ * @param[in] beg   Input string begin.
+ * @param[in] end   Input string end.
+ * 
+ * @return unsigned int     Hash value.
+ */
+unsigned int miniopt_hash(const char *beg, const char *end) {
+    unsigned int h = 2166136261u;
+    while (beg < end) {
+        h ^= (unsigned char)*beg++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
 /**
  * @brief Check whether input string is long option.
  * 
+ * @param[in] spec      Option spec.
  * @param[in] beg       Input string begin.
  * @param[in] end       Input string end.
  * @param[out] hasArg   Whether this option requires an argument.
@@ -269,28 +631,87 @@ int miniopt_is_same(const char *beg, const char *end, const char *str) {
  * @return 1            It is long option.
  * @return 0            It is not long option.
  */
-int miniopt_is_long_option(const char *beg, const char *end, int *hasArg,
-                           int *optind) {
+int miniopt_is_long_option(const option_spec *spec, const char *beg,
+                           const char *end, int *hasArg, int *optind) {
     miniopt_assert(hasArg != nil);
     miniopt_assert(optind != nil);
 
     *hasArg = 0;
-    *optind = optctx.optsum;
+    *optind = spec->optsum;
 
     if(beg == nil || end == nil) return 0;
 
     if (beg < end) {
-        for (int i = 0; i < optctx.optsum; ++i) {
-            if (miniopt_is_same(beg, end, optctx.opts[i].lname)) {
-                *hasArg = miniopt_opt_has_arg(&(optctx.opts[i]));
+        if (spec->lookup) {
+            int i = spec->lookup(beg, end);
+            if (i < 0 || i >= spec->optsum) return 0;
+            *hasArg = miniopt_opt_has_arg(&(spec->opts[i]));
+            *optind = i;
+            return 1;
+        }
+
+        const unsigned int mask = spec->longMask;
+#ifdef USING_MINIOPT_SIMD
+        MINIOPT_ALIGN(32) option_name name;
+        if (!miniopt_make_name(&name, beg, end)) return 0;
+#endif
+        unsigned int slot = miniopt_hash(beg, end) & mask;
+        int i;
+        while ((i = spec->longIndex[slot]) >= 0) {
+#ifdef USING_MINIOPT_SIMD
+            if (miniopt_is_same_name(&spec->longNames[slot], &name)) {
+#else
+            if (miniopt_is_same(beg, end, spec->opts[i].lname)) {
+#endif
+                *hasArg = miniopt_opt_has_arg(&(spec->opts[i]));
                 *optind = i;
                 return 1;
             }
+            slot = (slot + 1) & mask;
         }
     }
     return 0;
 }
 
+#ifdef USING_MINIOPT_ABBREV
+/**
+ * @brief Resolve a long name abbreviation by the trie.
+ * 
+ * It walks the trie once by the name chars, so it is O(name size). A name
+ * that is a whole long name wins, even if it is a prefix of other ones.
+ * 
+ * @param[in] spec          Option spec.
+ * @param[in] beg           Name begin.
+ * @param[in] end           Name end.
+ * @param[out] hasArg       Whether the option has an argument.
+ * @param[out] optind       Option index.
+ * 
+ * @return 1                It is a long name, or the prefix of only one.
+ * @return 0                It is not a prefix of any long name.
+ * @return -1               It is the prefix of more than one long name.
+ */
+int miniopt_find_abbrev(const option_spec *spec, const char *beg,
+                        const char *end, int *hasArg, int *optind) {
+    int node = 0;
+    for (; beg < end; ++beg) {
+        int child = spec->trie[node].child;
+        while (child != 0 && spec->trie[child].c != *beg) {
+            child = spec->trie[child].next;
+        }
+        if (child == 0) return 0;
+        node = child;
+    }
+    if (node == 0) return 0;
+
+    int i = spec->trie[node].end;
+    if (i < 0) i = spec->trie[node].optind;
+    if (i < 0) return -1;
+    *optind = i;
+    *hasArg = miniopt_opt_has_arg(&spec->opts[i]);
+    return 1;
+}
+#endif
+
 int miniopt_strlen(const char* s)
 {
     int len = 0;
@@ -321,52 +742,91 @@ int miniopt_find(const char *str, char c) {
     return 0;
 }
 
+/**
+ * @brief Check the bound kind of an option.
+ * 
+ * @param[in] opt   Option.
+ * 
+ * @return 0        Check pass.
+ * @return -1       Kind is unknown, dest is nil, or argument is not matched.
+ */
+int miniopt_check_kind(const option *opt) {
+    switch (opt->kind) {
+        case MINIOPT_KIND_NONE:
+            return 0;
+        case MINIOPT_KIND_FLAG:
+        case MINIOPT_KIND_COUNTER:
+            return (opt->dest != nil && !miniopt_opt_has_arg(opt)) ? 0 : -1;
+        case MINIOPT_KIND_STRING:
+        case MINIOPT_KIND_INT:
+        case MINIOPT_KIND_LIST:
+            return (opt->dest != nil && miniopt_opt_has_arg(opt)) ? 0 : -1;
+        case MINIOPT_KIND_CALLBACK:
+            return opt->dest != nil ? 0 : -1;
+        default:
+            return -1;
+    }
+}
+
 /**
  * @brief Simple check input options.
  * 
+ * @param[in] spec  Option spec.
+ * 
  * @return 0    Check pass.
  * @return -1   Check fail. 
  */
-int miniopt_simple_check() {
+int miniopt_simple_check(option_spec *spec) {
     dbg("check options begin...\n");
 
-    for (int i = 0; i < optctx.optsum; ++i) {
-        if (optctx.opts[i].sname == nil && optctx.opts[i].lname == nil) {
-            miniopt_make_error(
-                "Option index = ", miniopt_to_string(i),
+    for (int i = 0; i < spec->optsum; ++i) {
+        if (spec->opts[i].sname == nil && spec->opts[i].lname == nil) {
+            miniopt_make_spec_error(
+                spec, i,
                 ", At least one of the short and long names cannot be nil.");
             return -1;
         }
-        if (optctx.opts[i].sname == '-') {
-            miniopt_make_error(
-                "Option index = ", miniopt_to_string(i),
+        if (spec->opts[i].sname == '-') {
+            miniopt_make_spec_error(
+                spec, i,
                 ", Character [-] cannot be used as short option.");
             return -1;
         }
-        if (optctx.opts[i].sname == '=') {
-            miniopt_make_error(
-                "Option index = ", miniopt_to_string(i),
+        if (spec->opts[i].sname == '=') {
+            miniopt_make_spec_error(
+                spec, i,
                 ", Character [=] cannot be used as short option.");
             return -1;
         }
-        if (optctx.opts[i].lname && optctx.opts[i].lname[0] == '-') {
-            miniopt_make_error(
-                "Option index = ", miniopt_to_string(i),
+        if (spec->opts[i].lname && spec->opts[i].lname[0] == '-') {
+            miniopt_make_spec_error(
+                spec, i,
                 ", Character [-] cannot be long option's first char.");
             return -1;
         }
-        if (miniopt_find(optctx.opts[i].lname, '=')) {
-            miniopt_make_error(
-                "Option index = ", miniopt_to_string(i),
+        if (miniopt_find(spec->opts[i].lname, '=')) {
+            miniopt_make_spec_error(
+                spec, i,
                 ", Character [=] cannot be used in long option.");
             return -1;
         }
-        if(miniopt_strlen(optctx.opts[i].lname) > OPTION_NAME_MAX_SIZE){
-            miniopt_make_error(
-                "Option index = ", miniopt_to_string(i),
+        if(miniopt_strlen(spec->opts[i].lname) > OPTION_NAME_MAX_SIZE){
+            miniopt_make_spec_error(
+                spec, i,
                 ", long name size cannot more than OPTION_NAME_MAX_SIZE.");
             return -1; 
         }
+        if (miniopt_check_kind(&spec->opts[i]) != 0) {
+            miniopt_make_spec_error(
+                spec, i, ", bound kind does not match its dest or argument.");
+            return -1;
+        }
+        const char *env = spec->opts[i].env;
+        if (env && (env[0] == '\0' || miniopt_find(env, '='))) {
+            miniopt_make_spec_error(
+                spec, i, ", env name cannot be empty or use character [=].");
+            return -1;
+        }
     }
 
     dbg("check options pass.\n");
@@ -375,395 +835,3257 @@ int miniopt_simple_check() {
 }
 
 /**
- * @brief Initialize miniopt object.
- *
- * @param[in] argc      Argument array size.
- * @param[in] argv      Argument array.
- * @param[in] opts      Option array.
- * @param[in] optsum    Option sum of the option array.
+ * @brief Add an option to the help text column layout.
  *
- * @return 0            Init pass.
- * @return other        Init error.
+ * @param[in,out] layout    Column layout, it starts from zero.
+ * @param[in] opt           Option.
  */
-int miniopt_init_impl(int argc, char **argv, option *opts, int optsum) {
-    miniopt_assert(argc > 0);
-    miniopt_assert(argv != nil);
-    miniopt_assert(opts != nil);
-    miniopt_assert(optsum > 0);
+void miniopt_help_layout_add(option_layout *layout, const option *opt) {
+    int total = 0;
 
-    optctx.argc = argc;
-    optctx.argv = argv;
+    int shortOptSize = opt->sname ? 1 : 0;
+    if(layout->shortSize < shortOptSize){
+        shortOptSize += 1;  // For the leading '-'
+        layout->shortSize = shortOptSize;
+        total += shortOptSize;
+    }
 
-    optctx.opts = opts;
-    optctx.optsum = optsum;
+    int longOptSize = miniopt_strlen(opt->lname);
+    if(layout->longSize < longOptSize){
+        longOptSize += 2;  // For the leading '--'
+        layout->longSize = longOptSize;
+        total += longOptSize;
+    }
 
-    optctx.optind = optsum;
-    optctx.optarg = nil;
-    optctx.error = nil;
+    int ahintSize = miniopt_strlen(opt->ahint);
+    if(layout->ahintSize < ahintSize){
+        ahintSize += 1; // For the leading ' '
+        layout->ahintSize = ahintSize;
+        total += ahintSize;
+    }
+    if(layout->offset < total){
+        layout->offset = total;
+    }
+}
 
-    optctx.index = -1;
-    optctx.token = nil;
-    optctx.it = nil;
-    optctx.state = state_start;
+/**
+ * @brief End the help text column layout after the last option is added.
+ *
+ * @param[in,out] layout    Column layout.
+ */
+void miniopt_help_layout_end(option_layout *layout) {
+    // Add space between short name and long name like "-k --key".
+    if(layout->shortSize && layout->longSize) layout->offset += 1;
+    // Add spaces before opt.desc
+    layout->offset += 3;
+}
 
-    return miniopt_simple_check();
+/**
+ * @brief Compute the help text column layout of the option array.
+ *
+ * @param[in] spec      Option spec.
+ * @param[out] layout   Column layout.
+ */
+void miniopt_help_layout(const option_spec *spec, option_layout *layout) {
+    option_layout zero = {0, 0, 0, 0};
+    *layout = zero;
+    for (int i = 0; i < spec->optsum; ++i) {
+        miniopt_help_layout_add(layout, &spec->opts[i]);
+    }
+    miniopt_help_layout_end(layout);
 }
 
 /**
- * @brief Get next option.
+ * @brief Build the short name lookup table.
  * 
- * It should be used after miniopt.init();
- *
- * @return MINIOPT_PASS    Get next option pass.
- * @return MINIOPT_FINISHED     Work finished ok(no more option to get).
- * @return MINIOPT_ERROR        Work finished or stopped with error.
+ * Every short option lookup is one indexed load after this, a short name
+ * used more than once is found by the same table. List options are marked
+ * and the help text column layout is got in the same pass.
+ * 
+ * @param[in] spec  Option spec.
+ * 
+ * @return 0        Build pass.
+ * @return -1       A short name is used more than once.
  */
-int miniopt_getopt_impl() {
-    switch (optctx.state) {
-        case state_start: {
-            optctx.token = miniopt_get_next_token();
-            if (optctx.token == nil) {
-                optctx.state = state_finished;
-                break;
-            } else if (optctx.token[0] == '-') {
-                // May be short option.
-                int needArg;
-                int optind;
-                if (miniopt_is_short_option(optctx.token[1], &needArg,
-                                            &optind)) {
-                    // It is short option like "-x".
-                    optctx.optind = optind;
-                    if (needArg) {
-                        // Short option has an arg.
-                        if (optctx.token[2] != 0) {
-                            // It is "-xarg" or "-x=arg"
-                            if (optctx.token[2] != '=') {
-                                // "-xarg"
-                                optctx.optarg = &(optctx.token[2]);
-                                return MINIOPT_PASS;
-                            } else if (optctx.token[2] == '=' 
-                                       && optctx.token[3] != 0) {
-                                // "-x=arg"
-                                optctx.optarg = &(optctx.token[3]);
-                                return MINIOPT_PASS;
-                            } else {
-                                miniopt_make_error(
-                                    "option ",
-                                    optctx.token,
-                                    " argument is missing.");
-                                return MINIOPT_ERROR;
-                            }
-                        } else if (miniopt_peek_next_token() != nil) {
-                            // "-x arg"
-                            optctx.optarg = miniopt_get_next_token();
-                            return MINIOPT_PASS;
-                        } else {
-                            miniopt_make_error("option ",
-                                               optctx.token,
-                                               " argument is missing.");
-                            return MINIOPT_ERROR;
-                        }
-                    } else {
-                        // (All) short option has no arg.
-                        // "-x" equal to "-x"
-                        // "-abc" equal to "-a -b -c"
-                        optctx.optarg = nil;
-                        optctx.it = &(optctx.token[1]);
-                        // Run into this state to split "-abc" to "-a -b -c".
-                        optctx.state = state_short_opt_no_arg;
-                        return MINIOPT_PASS;
-                    }
-                } else if (optctx.token[1] == '-') { // May be long option.
-                    if (optctx.token[2] == '\0') {
-                        // Option is "--", it is non-option-argument marker. 
-                        optctx.state = state_double_dash;
-                        return miniopt_getopt_impl();
-                    } else {
-                        // Find a long option.
-                        const char *beg = &(optctx.token[2]);
-                        const char *end = beg;
-                        // Long option cannot begin with '=' or '-';
-                        if (*beg != '\0' && *beg != '=' && *beg != '-') {
-                            ++end;
-                            while (*end != '\0' && *end != '=') { ++end; }
-                        }
+int miniopt_build_short_index(option_spec *spec) {
+    int *slots = spec->shortSlots;
+    unsigned char *bits = spec->shortArgBits;
+    for (int c = 0; c < 256; ++c) { slots[c] = -1; }
+    for (int c = 0; c < 32; ++c) { bits[c] = 0; }
+    spec->shortIndex = slots;
+    spec->shortHasArg = bits;
+    option_layout zero = {0, 0, 0, 0};
+    spec->layout = zero;
 
-                        int needArg;
-                        int optind;
-                        if (miniopt_is_long_option(beg, end, &needArg,
-                                                   &optind)) {
-                            // option like "--key...";
-                            optctx.optind = optind;
-                            if (needArg) {
-                                // option like "--key=value" or "--key value"
-                                if (*(end) != '\0') {
-                                    // " --key=value"
-                                    if (*end == '=' && *(end + 1) != '\0') {
-                                        optctx.optarg = end + 1;
-                                        return MINIOPT_PASS;
-                                    } else {
-                                        miniopt_make_error(
-                                            "option ",
-                                            optctx.token,
-                                            " argument is missing.");
-                                        return MINIOPT_ERROR;
-                                    }
-                                } else if (miniopt_peek_next_token() != nil) {
-                                    // "--key value"
-                                    optctx.optarg = miniopt_get_next_token();
-                                    return MINIOPT_PASS;
-                                } else {
-                                    miniopt_make_error(
-                                        "option ", optctx.token,
-                                        ", argument is missing.");
-                                    return MINIOPT_ERROR;
-                                }
-                            } else {
-                                if (*end == '\0') {
-                                // option like "--key" has no arg.
-                                    optctx.optarg = nil;
-                                    return MINIOPT_PASS;
-                                } else {
-                                    miniopt_make_error(
-                                        "option ", optctx.token,
-                                        " is unknown.");
-                                    return MINIOPT_ERROR;
-                                }
-                            }
-                        } else {
-                            miniopt_make_error("option ",
-                                               optctx.token,
-                                               " is unknown.");
-                            return MINIOPT_ERROR;
-                        }
-                    }
-                } else {
-                    // Token begin with '-', but it is not an option.
-                    miniopt_make_error("option ", optctx.token,
-                                       " is unknown.");
-                    return MINIOPT_ERROR;
-                }
-            } else if (optctx.token[0] == '\0') {
-                // Empty string, just skip it.
-                return miniopt_getopt_impl(optctx);
-            } else {
-                // return non-option-argument;
-                optctx.optind = optctx.optsum;
-                optctx.optarg = optctx.token;
-                return MINIOPT_PASS;
-            }
-        }
-        case state_double_dash: {
-            // All the tokens are non-option-argument;
-            const char *optarg = miniopt_get_next_token();
-            if (optarg != nil) {
-                optctx.optarg = optarg;
-                optctx.optind = optctx.optsum;
-                return MINIOPT_PASS;
-            } else {
-                optctx.state = state_finished;
-                break;
-            }
-        }
-        case state_short_opt_no_arg: {
-            // split "-abc" to "-a -b -c".
-            if (*(++optctx.it) != '\0') {
-                int needArg;
-                int optind;
-                if (miniopt_is_short_option(*(optctx.it), &needArg,
-                                            &optind) &&
-                    needArg == 0) {
-                    optctx.optind = optind;
-                    optctx.optarg = nil;
-                    return MINIOPT_PASS;
-                } else {
-                    miniopt_make_error("option ", optctx.token,
-                                       " has error.");
-                    return MINIOPT_ERROR;
-                }
-            } else {
-                // Restart.
-                optctx.state = state_start;
-                return miniopt_getopt_impl(optctx);
-            }
+    for (int i = 0; i < spec->optsum; ++i) {
+        if (spec->opts[i].kind == MINIOPT_KIND_LIST) spec->listed = 1;
+        miniopt_help_layout_add(&spec->layout, &spec->opts[i]);
+        unsigned char uc = (unsigned char)spec->opts[i].sname;
+        if (uc == nil) continue;
+        if (slots[uc] >= 0) {
+            miniopt_make_dup_error(spec, i, slots[uc],
+                                   ", short name is used by option index = ");
+            return -1;
         }
-        case state_error: {
-            optctx.optind = optctx.optsum;
-            optctx.optarg = nil;
-            return MINIOPT_ERROR;
+        slots[uc] = i;
+        if (miniopt_opt_has_arg(&(spec->opts[i]))) {
+            bits[uc >> 3] |= (unsigned char)(1 << (uc & 7));
         }
-        case state_finished:
-            optctx.optind = optctx.optsum;
-            optctx.optarg = nil;
-        default:
-            break;
     }
+    miniopt_help_layout_end(&spec->layout);
 
+    return 0;
+}
+
+/**
+ * @brief Align a pointer up.
+ *
+ * @param[in] ptr       Pointer.
+ * @param[in] align     Alignment, it should be power of 2.
+ *
+ * @return char*        Aligned pointer, it is not before ptr.
+ */
+char *miniopt_align_up(void *ptr, uintptr_t align) {
+    uintptr_t p = (uintptr_t)ptr;
+    return (char *)ptr + ((align - p % align) % align);
+}
+
+/**
+ * @brief Get the long name hash slots, from the spec or the allocator.
+ * 
+ * The slots are the power of 2 of at least twice the long names(at least
+ * LONG_INDEX_MIN_SIZE), so the load factor is not more than 1/2 and init
+ * clears only them. A table bigger than the inline slots is got from the
+ * spec allocator in one block.
+ * 
+ * @param[in] spec  Option spec.
+ * @param[in] count Long name sum.
+ * 
+ * @return 0        Get pass.
+ * @return -1       No allocator, or it cannot allocate.
+ */
+int miniopt_alloc_long_index(option_spec *spec, int count) {
+    unsigned int slots = LONG_INDEX_MIN_SIZE;
+    while (slots / 2 < (unsigned int)count) slots *= 2;
+
+    spec->longIndex = spec->longSlots;
+#ifdef USING_MINIOPT_SIMD
+    spec->longNames = spec->longNameSlots;
+#endif
+    spec->longMask = slots - 1;
+    if (slots <= LONG_INDEX_INLINE_SIZE) return 0;
+
+    int size = (int)(slots * sizeof(int));
+#ifdef USING_MINIOPT_SIMD
+    size += (int)(slots * sizeof(option_name)) + 32;
+#endif
+    char *buf = spec->alloc.fn == nil
+                    ? nil
+                    : (char *)spec->alloc.fn(spec->alloc.user, nil, size);
+    if (buf == nil) {
+        miniopt_make_spec_error(spec, count - 1,
+                                ", long names are more than "
+                                "LONG_INDEX_INLINE_SIZE / 2 without memory.");
+        return -1;
+    }
+    spec->longBuf = buf;
+    spec->longIndex = (int *)buf;
+#ifdef USING_MINIOPT_SIMD
+    char *names = buf + slots * sizeof(int);
+    spec->longNames = (option_name *)miniopt_align_up(names, 32);
+#endif
+    return 0;
+}
+
+/**
+ * @brief Build the long name hash index.
+ * 
+ * It uses open addressing with linear probing, the slots are sized from the
+ * long name sum, see miniopt_alloc_long_index(). Every long name is
+ * inserted once, a long name used more than once is found when it collides
+ * with the first one, so the check is O(optsum).
+ * 
+ * @param[in] spec  Option spec.
+ * 
+ * @return 0        Build pass.
+ * @return -1       A long name is used more than once, or no memory.
+ */
+int miniopt_build_long_index(option_spec *spec) {
+    int count = 0;
+    for (int i = 0; i < spec->optsum; ++i) {
+        if (spec->opts[i].lname) ++count;
+    }
+    if (miniopt_alloc_long_index(spec, count) != 0) return -1;
+
+    const unsigned int mask = spec->longMask;
+    for (unsigned int i = 0; i <= mask; ++i) spec->longIndex[i] = -1;
+
+    for (int i = 0; i < spec->optsum; ++i) {
+        const char *beg = spec->opts[i].lname;
+        if (beg == nil) continue;
+        const char *end = beg + miniopt_strlen(beg);
+
+        unsigned int slot = miniopt_hash(beg, end) & mask;
+        int j;
+        while ((j = spec->longIndex[slot]) >= 0) {
+            if (miniopt_is_same(beg, end, spec->opts[j].lname)) {
+                miniopt_make_dup_error(
+                    spec, i, j, ", long name is used by option index = ");
+                return -1;
+            }
+            slot = (slot + 1) & mask;
+        }
+        spec->longIndex[slot] = i;
+#ifdef USING_MINIOPT_SIMD
+        miniopt_make_name(&spec->longNames[slot], beg, end);
+#endif
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Check the long names by the user lookup function.
+ * 
+ * Every long name should be found as its own option, so a long name used
+ * more than once is found in one pass.
+ * 
+ * @param[in] spec  Option spec.
+ * 
+ * @return 0        Check pass.
+ * @return -1       A long name is used more than once, or lookup is wrong.
+ */
+int miniopt_check_lookup(option_spec *spec) {
+    for (int i = 0; i < spec->optsum; ++i) {
+        const char *beg = spec->opts[i].lname;
+        if (beg == nil) continue;
+        int j = spec->lookup(beg, beg + miniopt_strlen(beg));
+        if (j == i) continue;
+        if (j < 0 || j >= spec->optsum) {
+            miniopt_make_spec_error(spec, i,
+                                    ", long name is not found by lookup.");
+        } else {
+            miniopt_make_dup_error(spec, i, j,
+                                   ", long name is used by option index = ");
+        }
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Build the environment variable name hash index.
+ * 
+ * It uses open addressing with linear probing like the long name index, an
+ * env name used more than once is found when it is inserted.
+ * 
+ * @param[in] spec  Option spec.
+ * 
+ * @return 0        Build pass.
+ * @return -1       Env names are too many, or one is used more than once.
+ */
+int miniopt_build_env_index(option_spec *spec) {
+    const unsigned int mask = ENV_INDEX_MAX_SIZE - 1;
+    int *slots = spec->envSlots;
+    int count = 0;
+
+    spec->envIndex = slots;
+    spec->envMask = mask;
+    spec->envIndexed = 0;
+    for (int i = 0; i < spec->optsum; ++i) {
+        if (spec->opts[i].env == nil) continue;
+        if (++count > ENV_INDEX_MAX_SIZE / 2) {
+            miniopt_make_spec_error(spec, i,
+                                    ", env names are more than "
+                                    "ENV_INDEX_MAX_SIZE / 2.");
+            return -1;
+        }
+        if (count == 1) {
+            for (int j = 0; j < ENV_INDEX_MAX_SIZE; ++j) slots[j] = -1;
+        }
+
+        const char *beg = spec->opts[i].env;
+        const char *end = beg + miniopt_strlen(beg);
+        unsigned int slot = miniopt_hash(beg, end) & mask;
+        int j;
+        while ((j = slots[slot]) >= 0) {
+            if (miniopt_is_same(beg, end, spec->opts[j].env)) {
+                miniopt_make_dup_error(
+                    spec, i, j, ", env name is used by option index = ");
+                return -1;
+            }
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = i;
+    }
+    spec->envIndexed = count > 0;
+
+    return 0;
+}
+
+#ifdef USING_MINIOPT_ABBREV
+/**
+ * @brief Build the long name trie for abbreviations.
+ * 
+ * Each node keeps the only option below it, or -2 if there are more, so an
+ * abbreviation is resolved without visiting the names below. A node where
+ * a long name ends keeps that option too, so "--color" is not ambiguous
+ * with "--colors".
+ * 
+ * @param[in] spec  Option spec.
+ * 
+ * @return 0        Build pass.
+ * @return -1       The trie needs more than ABBREV_NODE_MAX_SIZE nodes, or
+ *                  a long name is used more than once.
+ */
+int miniopt_build_trie(option_spec *spec) {
+    option_trie_node *trie = spec->trie;
+    trie[0].child = 0;
+    trie[0].next = 0;
+    trie[0].optind = -2;
+    trie[0].end = -1;
+    trie[0].c = '\0';
+    spec->trieSize = 1;
+
+    for (int i = 0; i < spec->optsum; ++i) {
+        const char *name = spec->opts[i].lname;
+        if (name == nil) continue;
+
+        int node = 0;
+        for (; *name; ++name) {
+            int child = trie[node].child;
+            while (child != 0 && trie[child].c != *name) {
+                child = trie[child].next;
+            }
+            if (child == 0) {
+                if (spec->trieSize >= ABBREV_NODE_MAX_SIZE) {
+                    miniopt_make_spec_error(
+                        spec, i, ", long names are too many to abbreviate.");
+                    return -1;
+                }
+                child = spec->trieSize++;
+                trie[child].child = 0;
+                trie[child].next = trie[node].child;
+                trie[child].optind = i;
+                trie[child].end = -1;
+                trie[child].c = *name;
+                trie[node].child = child;
+            } else {
+                trie[child].optind = -2;    // Shared by more options.
+            }
+            node = child;
+        }
+
+        if (trie[node].end >= 0) {
+            miniopt_make_dup_error(spec, i, trie[node].end,
+                                   ", long name is used by option index = ");
+            return -1;
+        }
+        trie[node].end = i;
+    }
+
+    return 0;
+}
+#endif
+
+/**
+ * @brief Initialize an option spec, with or without the option checks.
+ *
+ * @param[out] spec     Option spec to initialize.
+ * @param[in] opts      Option array.
+ * @param[in] optsum    Option sum of the option array.
+ * @param[in] lookup    User long name lookup function, it can be nil.
+ * @param[in] fn        Allocator function of the spec, it can be nil.
+ * @param[in] user      User data of the allocator function.
+ * @param[in] checked   Not 0 to check the options and the lookup function.
+ * @param[in] tables    Prebuilt short and env name indexes, or nil to
+ *                      build them.
+ *
+ * @return 0            Init pass.
+ * @return other        Init error, see miniopt_spec_what().
+ */
+int miniopt_spec_setup(option_spec *spec, option *opts, int optsum,
+                       lookup_fn lookup, alloc_fn fn, void *user,
+                       int checked, const option_tables *tables) {
+    miniopt_assert(spec != nil);
+    miniopt_assert(opts != nil);
+    miniopt_assert(optsum > 0);
+
+    spec->alloc.fn = fn;
+    spec->alloc.user = user;
+    spec->opts = opts;
+    spec->optsum = optsum;
+    spec->lookup = lookup;
+    spec->longBuf = nil;
+    spec->ruled = 0;
+    spec->listed = 0;
+    spec->commands = nil;
+    spec->commandsum = 0;
+    spec->error = nil;
+
+    if (checked && miniopt_simple_check(spec) != 0) return -1;
+
+    if (tables != nil) {
+        spec->shortIndex = tables->shortIndex;
+        spec->shortHasArg = tables->shortHasArg;
+        spec->envIndex = tables->envIndex;
+        spec->envMask = tables->envMask;
+        spec->envIndexed = tables->envIndex != nil;
+        spec->listed = tables->listed;
+        spec->layout = tables->layout;
+        if (spec->layout.offset == 0) {
+            miniopt_help_layout(spec, &spec->layout);
+        }
+    } else if (miniopt_build_short_index(spec) != 0) {
+        return -1;
+    }
+    if (spec->lookup != nil) {
+        if (checked && miniopt_check_lookup(spec) != 0) return -1;
+    } else if (miniopt_build_long_index(spec) != 0) {
+        return -1;
+    }
+#ifdef USING_MINIOPT_ABBREV
+    if (miniopt_build_trie(spec) != 0) return -1;
+#endif
+    if (tables == nil && miniopt_build_env_index(spec) != 0) return -1;
+
+    return 0;
+}
+
+/**
+ * @brief Initialize an option spec.
+ *
+ * @param[out] spec     Option spec to initialize.
+ * @param[in] opts      Option array.
+ * @param[in] optsum    Option sum of the option array.
+ * @param[in] lookup    User long name lookup function, it can be nil.
+ *
+ * @return 0            Init pass.
+ * @return other        Init error, see miniopt_spec_what().
+ */
+int miniopt_spec_init(option_spec *spec, option *opts, int optsum,
+                      lookup_fn lookup) {
+    return miniopt_spec_setup(spec, opts, optsum, lookup,
+                              MINIOPT_DEFAULT_ALLOC, nil, 1, nil);
+}
+
+/**
+ * @brief Initialize an option spec with an allocator.
+ *
+ * The allocator is used only if the long names are more than
+ * LONG_INDEX_INLINE_SIZE / 2, see miniopt_spec_release().
+ *
+ * @param[out] spec     Option spec to initialize.
+ * @param[in] opts      Option array.
+ * @param[in] optsum    Option sum of the option array.
+ * @param[in] lookup    User long name lookup function, it can be nil.
+ * @param[in] fn        Allocator function, nil for no allocator.
+ * @param[in] user      User data of the allocator function.
+ *
+ * @return 0            Init pass.
+ * @return other        Init error, see miniopt_spec_what().
+ */
+int miniopt_spec_init_alloc(option_spec *spec, option *opts, int optsum,
+                            lookup_fn lookup, alloc_fn fn, void *user) {
+    return miniopt_spec_setup(spec, opts, optsum, lookup, fn, user, 1, nil);
+}
+
+/**
+ * @brief Release the memory got by an option spec from its allocator.
+ *
+ * @param[in] spec      Option spec.
+ */
+void miniopt_spec_release(option_spec *spec) {
+    if (spec->longBuf != nil && spec->alloc.fn != nil) {
+        spec->alloc.fn(spec->alloc.user, spec->longBuf, 0);
+    }
+    spec->longBuf = nil;
+}
+
+/**
+ * @brief Initialize an option spec from a prevalidated option array.
+ *
+ * The options and the lookup function are not checked, the option array
+ * should pass miniopt_static_check() or the code generator checks. A name
+ * used more than once is still found when the indexes are built.
+ *
+ * @param[out] spec     Option spec to initialize.
+ * @param[in] opts      Option array.
+ * @param[in] optsum    Option sum of the option array.
+ * @param[in] lookup    User long name lookup function, it can be nil.
+ *
+ * @return 0            Init pass.
+ * @return other        Init error, see miniopt_spec_what().
+ */
+int miniopt_spec_init_prevalidated(option_spec *spec, option *opts,
+                                   int optsum, lookup_fn lookup) {
+    return miniopt_spec_setup(spec, opts, optsum, lookup,
+                              MINIOPT_DEFAULT_ALLOC, nil, 0, nil);
+}
+
+/**
+ * @brief Initialize an option spec from a prevalidated option array and its
+ * prebuilt tables.
+ *
+ * @param[out] spec     Option spec to initialize.
+ * @param[in] opts      Option array.
+ * @param[in] optsum    Option sum of the option array.
+ * @param[in] lookup    User long name lookup function, it should not be nil.
+ * @param[in] tables    Prebuilt tables of the option array.
+ *
+ * @return 0            Init pass.
+ * @return other        Init error, see miniopt_spec_what().
+ */
+int miniopt_spec_init_tables(option_spec *spec, option *opts, int optsum,
+                             lookup_fn lookup, const option_tables *tables) {
+    miniopt_assert(tables != nil);
+    return miniopt_spec_setup(spec, opts, optsum, lookup,
+                              MINIOPT_DEFAULT_ALLOC, nil, 0, tables);
+}
+
+/**
+ * @brief Get the name indexes of an initialized option spec.
+ *
+ * @param[in] spec      Option spec.
+ * @param[out] tables   Tables point into the spec.
+ */
+void miniopt_spec_tables(const option_spec *spec, option_tables *tables) {
+    tables->shortIndex = spec->shortIndex;
+    tables->shortHasArg = spec->shortHasArg;
+    tables->envIndex = spec->envIndexed ? spec->envIndex : nil;
+    tables->envMask = spec->envMask;
+    tables->listed = spec->listed;
+    tables->layout = spec->layout;
+}
+
+/**
+ * @brief Get option spec init error str.
+ *
+ * @param[in] spec      Option spec.
+ *
+ * @return not nil      An error str.
+ * @return nil          No error.
+ */
+const char *miniopt_spec_what(const option_spec *spec) {
+    return spec->error;
+}
+
+/**
+ * @brief Make a subcommand error string.
+ *
+ * @param[in] spec      Option spec.
+ * @param[in] index     Subcommand index.
+ * @param[in] s         Input string.
+ */
+void miniopt_make_command_error(option_spec *spec, int index, const char *s) {
+    char buf[32];
+    miniopt_concat(spec->errbuf, ERROR_STR_MAX_SIZE, "Command index = ",
+                   miniopt_to_string(buf, sizeof(buf), index), s);
+    spec->error = spec->errbuf;
+}
+
+/**
+ * @brief Find a subcommand by name.
+ *
+ * @param[in] spec      Option spec.
+ * @param[in] name      Subcommand name.
+ *
+ * @return [0, commandsum-1]    Subcommand index.
+ * @return -1                   Not found.
+ */
+int miniopt_find_command(const option_spec *spec, const char *name) {
+    const unsigned int mask = COMMAND_INDEX_MAX_SIZE - 1;
+    const char *end = name + miniopt_strlen(name);
+    unsigned int slot = miniopt_hash(name, end) & mask;
+    int k;
+    while ((k = spec->commandIndex[slot]) >= 0) {
+        if (miniopt_is_same(name, end, spec->commands[k].name)) return k;
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+/**
+ * @brief Add subcommands into the option spec.
+ *
+ * Only the names are hashed here, so it is O(cmdsum) whatever the option
+ * arrays of the subcommands are.
+ *
+ * @param[in,out] spec  Option spec.
+ * @param[in] cmds      Subcommand array.
+ * @param[in] cmdsum    Subcommand sum of the subcommand array.
+ *
+ * @return 0            Add pass.
+ * @return other        A name is not valid or used more than once.
+ */
+int miniopt_spec_commands(option_spec *spec, const option_command *cmds,
+                          int cmdsum) {
+    miniopt_assert(spec != nil);
+    miniopt_assert(cmds != nil || cmdsum == 0);
+
+    const unsigned int mask = COMMAND_INDEX_MAX_SIZE - 1;
+    spec->commands = nil;
+    spec->commandsum = 0;
+    if (cmdsum > COMMAND_INDEX_MAX_SIZE / 2) {
+        miniopt_make_command_error(
+            spec, cmdsum - 1,
+            ", subcommands are more than COMMAND_INDEX_MAX_SIZE / 2.");
+        return -1;
+    }
+    for (int i = 0; i < COMMAND_INDEX_MAX_SIZE; ++i) {
+        spec->commandIndex[i] = -1;
+    }
+
+    for (int k = 0; k < cmdsum; ++k) {
+        const char *name = cmds[k].name;
+        if (name == nil || name[0] == '\0' || name[0] == '-' ||
+            cmds[k].opts == nil || cmds[k].optsum <= 0) {
+            miniopt_make_command_error(
+                spec, k, ", name or option array is not valid.");
+            return -1;
+        }
+        const char *end = name + miniopt_strlen(name);
+        unsigned int slot = miniopt_hash(name, end) & mask;
+        int j;
+        while ((j = spec->commandIndex[slot]) >= 0) {
+            if (miniopt_is_same(name, end, cmds[j].name)) {
+                char buf[32];
+                miniopt_make_command_error(spec, k, nil);
+                int size = miniopt_strlen(spec->errbuf);
+                miniopt_concat(spec->errbuf + size, ERROR_STR_MAX_SIZE - size,
+                               ", name is used by command index = ",
+                               miniopt_to_string(buf, sizeof(buf), j), ".");
+                return -1;
+            }
+            slot = (slot + 1) & mask;
+        }
+        spec->commandIndex[slot] = k;
+    }
+    spec->commands = cmds;
+    spec->commandsum = cmdsum;
+
+    return 0;
+}
+
+/**
+ * @brief Get the rule bit of an option.
+ * 
+ * @param[in] spec      Option spec.
+ * @param[in] optind    Option index.
+ * 
+ * @return int >= 0     Rule bit.
+ * @return -1           The option is not used by the rules.
+ */
+int miniopt_rule_bit(const option_spec *spec, int optind) {
+    unsigned int slot = (unsigned int)optind % RULE_INDEX_SIZE;
+    int bit;
+    while ((bit = spec->ruleSlots[slot]) >= 0) {
+        if (spec->ruleOptinds[bit] == optind) return bit;
+        slot = (slot + 1) % RULE_INDEX_SIZE;
+    }
+    return -1;
+}
+
+/**
+ * @brief Get the rule bit of an option, a new bit is added if it has none.
+ * 
+ * The hash slots are twice the bits, so a lookup is a probe or two.
+ * 
+ * @param[in,out] spec  Option spec.
+ * @param[in] optind    Option index.
+ * 
+ * @return int >= 0     Rule bit.
+ * @return -1           RULE_OPTION_MAX_SIZE options are used.
+ */
+int miniopt_add_rule_bit(option_spec *spec, int optind) {
+    unsigned int slot = (unsigned int)optind % RULE_INDEX_SIZE;
+    int bit;
+    while ((bit = spec->ruleSlots[slot]) >= 0) {
+        if (spec->ruleOptinds[bit] == optind) return bit;
+        slot = (slot + 1) % RULE_INDEX_SIZE;
+    }
+    if (spec->rulebits == RULE_OPTION_MAX_SIZE) return -1;
+
+    bit = spec->rulebits++;
+    spec->ruleSlots[slot] = bit;
+    spec->ruleOptinds[bit] = optind;
+    for (int j = 0; j < RULE_WORD_SIZE; ++j) {
+        spec->needs[bit][j] = 0;
+        spec->excludes[bit][j] = 0;
+    }
+    return bit;
+}
+
+/**
+ * @brief Compile option rules into the option spec.
+ * 
+ * Each option used by the rules gets a bit, each rule sets a bit of a
+ * bitset, exclusive rules are set in both ways, so a rule check is a few
+ * word operations whatever the rule sum is. The option array can be any
+ * size, at most RULE_OPTION_MAX_SIZE options can be used by the rules.
+ * 
+ * @param[in,out] spec  Option spec.
+ * @param[in] rules     Rule array.
+ * @param[in] rulesum   Rule sum of the rule array.
+ * 
+ * @return 0            Compile pass.
+ * @return other        A rule is not valid, see miniopt_spec_what().
+ */
+int miniopt_spec_rules(option_spec *spec, const option_rule *rules,
+                       int rulesum) {
+    miniopt_assert(spec != nil);
+    miniopt_assert(rules != nil || rulesum == 0);
+
+    spec->ruled = 0;
+    spec->rulebits = 0;
+    if (rulesum == 0) return 0;
+    for (int i = 0; i < RULE_INDEX_SIZE; ++i) spec->ruleSlots[i] = -1;
+    for (int i = 0; i < RULE_WORD_SIZE; ++i) {
+        spec->required[i] = 0;
+        spec->needing[i] = 0;
+    }
+
+    for (int k = 0; k < rulesum; ++k) {
+        const option_rule *rule = &rules[k];
+        int optind = rule->optind;
+        int other = rule->kind == MINIOPT_RULE_REQUIRED ? optind : rule->other;
+        if (optind < 0 || optind >= spec->optsum || other < 0 ||
+            other >= spec->optsum) {
+            miniopt_make_spec_error(spec, optind,
+                                    ", rule option is out of range.");
+            return -1;
+        }
+        int i = miniopt_add_rule_bit(spec, optind);
+        int j = i < 0 ? -1 : miniopt_add_rule_bit(spec, other);
+        if (j < 0) {
+            miniopt_make_spec_error(spec, i < 0 ? optind : other,
+                                    ", rules use more than "
+                                    "RULE_OPTION_MAX_SIZE options.");
+            return -1;
+        }
+        unsigned long long bit = 1ull << (j % 64);
+        switch (rule->kind) {
+            case MINIOPT_RULE_REQUIRED:
+                spec->required[j / 64] |= bit;
+                break;
+            case MINIOPT_RULE_REQUIRES:
+                spec->needs[i][j / 64] |= bit;
+                spec->needing[i / 64] |= 1ull << (i % 64);
+                break;
+            case MINIOPT_RULE_EXCLUSIVE:
+                if (i == j) {
+                    miniopt_make_spec_error(spec, optind,
+                                            ", rule excludes itself.");
+                    return -1;
+                }
+                spec->excludes[i][j / 64] |= bit;
+                spec->excludes[j][i / 64] |= 1ull << (i % 64);
+                break;
+            default:
+                miniopt_make_spec_error(spec, optind,
+                                        ", rule kind is not valid.");
+                return -1;
+        }
+    }
+    spec->ruled = rulesum > 0;
+
+    return 0;
+}
+
+/**
+ * @brief Initialize an option context.
+ *
+ * @param[out] ctx      Option context to initialize.
+ * @param[in] spec      Option spec, it should be initialized pass.
+ * @param[in] argc      Argument array size.
+ * @param[in] argv      Argument array.
+ */
+void miniopt_ctx_init(option_context *ctx, const option_spec *spec, int argc,
+                      char **argv) {
+    miniopt_assert(ctx != nil);
+    miniopt_assert(spec != nil);
+    miniopt_assert(argc > 0);
+    miniopt_assert(argv != nil);
+
+    ctx->spec = spec;
+
+    ctx->argc = argc;
+    ctx->argv = argv;
+    ctx->source = nil;
+    ctx->user = nil;
+
+    ctx->optind = spec->optsum;
+    ctx->optarg = nil;
+    ctx->optargsize = -1;
+    ctx->optname.data = nil;
+    ctx->optname.size = 0;
+    ctx->err.code = MINIOPT_ERR_NONE;
+    ctx->err.argind = -1;
+    ctx->err.optind = spec->optsum;
+    ctx->err.other = -1;
+    ctx->err.file = nil;
+    ctx->err.line = 0;
+    ctx->err.token = nil;
+    ctx->error = nil;
+    for (int i = 0; i < RULE_WORD_SIZE; ++i) ctx->seen[i] = 0;
+    ctx->alloc.fn = MINIOPT_DEFAULT_ALLOC;
+    ctx->alloc.user = nil;
+    ctx->last = nil;
+    ctx->listDone = 0;
+    ctx->fallbacks = nil;
+    ctx->fallbackNext = 0;
+    ctx->command = -1;
+    ctx->commandChecked = 0;
+    ctx->commandPending = 0;
+    ctx->subspec = nil;
+    ctx->subspecBuf = nil;
+    ctx->subspecMem = nil;
+    ctx->envp = nil;
+    ctx->envprefix = nil;
+
+    ctx->index = -1;
+    ctx->argind = -1;
+    ctx->peek.data = nil;
+    ctx->peek.size = -1;
+    ctx->peeked = 0;
+    ctx->token = nil;
+    ctx->it = nil;
+    ctx->state = state_start;
+
+#ifdef USING_MINIOPT_MMAP
+    ctx->rspIt = nil;
+    ctx->rspEnd = nil;
+    ctx->mapsum = 0;
+    ctx->configPath = nil;
+    ctx->configIt = nil;
+    ctx->configEnd = nil;
+    ctx->configLine = 0;
+#endif
+}
+
+/**
+ * @brief Initialize an option context reads tokens from a token source.
+ *
+ * @param[out] ctx      Option context to initialize.
+ * @param[in] spec      Option spec, it should be initialized pass.
+ * @param[in] source    Token source.
+ * @param[in] user      User data of the token source.
+ */
+void miniopt_ctx_init_source(option_context *ctx, const option_spec *spec,
+                             source_fn source, void *user) {
+    static char *argv[] = {(char *)""};
+    miniopt_assert(source != nil);
+
+    miniopt_ctx_init(ctx, spec, 1, argv);
+    ctx->source = source;
+    ctx->user = user;
+    ctx->index = 0;
+}
+
+/**
+ * @brief Initialize a NUL-delimited token stream.
+ *
+ * @param[out] stream   Token stream to initialize.
+ * @param[in] read      Read function.
+ * @param[in] user      User data of the read function.
+ */
+void miniopt_stream_init(option_stream *stream, read_fn read, void *user) {
+    miniopt_assert(stream != nil);
+    miniopt_assert(read != nil);
+
+    stream->read = read;
+    stream->user = user;
+    stream->pos = 0;
+    stream->len = 0;
+    stream->eof = 0;
+    stream->which = 0;
+}
+
+/**
+ * @brief Token source of a NUL-delimited token stream.
+ * 
+ * The token is copied into one of the two token buffers of the stream by
+ * turns, so it is valid until the source is called two more times.
+ *
+ * @param[in] user      The option_stream.
+ * @param[out] token    Output token.
+ *
+ * @return 1            Get a token.
+ * @return 0            No more token.
+ * @return -1           Read error, or the token is too long.
+ */
+int miniopt_stream_source(void *user, option_view *token) {
+    option_stream *stream = (option_stream *)user;
+    char *out = stream->tokens[stream->which];
+    int size = 0;
+    int ended = 0;
+
+    while (!ended) {
+        if (stream->pos >= stream->len) {
+            if (stream->eof) break;
+            int len = stream->read(stream->user, stream->buf, STREAM_BUF_SIZE);
+            if (len < 0) return -1;
+            if (len == 0) {
+                stream->eof = 1;
+                break;
+            }
+            stream->pos = 0;
+            stream->len = len;
+        }
+
+        // Copy until '\0' or the buffer end.
+        while (stream->pos < stream->len) {
+            char c = stream->buf[stream->pos++];
+            if (c == '\0') {
+                ended = 1;
+                break;
+            }
+            if (size >= STREAM_TOKEN_MAX_SIZE - 1) return -1;
+            out[size++] = c;
+        }
+    }
+
+    if (!ended && size == 0) return 0;  // Stream end.
+
+    out[size] = '\0';
+    token->data = out;
+    token->size = size;
+    stream->which ^= 1;
+    return 1;
+}
+
+/**
+ * @brief Align a caller buffer begin to pointer size.
+ *
+ * @param[in] buf       Buffer.
+ * @param[in,out] size  Buffer size, the padding is subtracted.
+ *
+ * @return char*        Aligned buffer begin.
+ */
+char *miniopt_align_buf(void *buf, int *size) {
+    int pad = (int)(miniopt_align_up(buf, sizeof(void *)) - (char *)buf);
+    if (pad > *size) pad = *size;
+    *size -= pad;
+    return (char *)buf + pad;
+}
+
+/**
+ * @brief Round a size up to pointer size.
+ */
+int miniopt_align_size(int size) {
+    const int align = (int)sizeof(void *);
+    return (size + align - 1) / align * align;
+}
+
+/**
+ * @brief Initialize an arena on a caller buffer.
+ *
+ * @param[out] arena    Arena.
+ * @param[in] buf       Arena buffer.
+ * @param[in] size      Arena buffer size.
+ */
+void miniopt_arena_init(option_arena *arena, void *buf, int size) {
+    miniopt_assert(arena != nil);
+    miniopt_assert(buf != nil || size == 0);
+
+    // Align the buffer begin, then each allocation keeps the alignment.
+    arena->data = miniopt_align_buf(buf, &size);
+    arena->size = size;
+    arena->used = 0;
+}
+
+/**
+ * @brief Allocate from an arena, it is aligned to pointer size.
+ *
+ * @param[in] arena     Arena.
+ * @param[in] size      Bytes to allocate.
+ *
+ * @return not nil      Allocated memory.
+ * @return nil          The arena is full.
+ */
+void *miniopt_arena_alloc(option_arena *arena, int size) {
+    int rounded = miniopt_align_size(size);
+    if (size < 0 || rounded > arena->size - arena->used) return nil;
+
+    void *p = arena->data + arena->used;
+    arena->used += rounded;
+    return p;
+}
+
+/**
+ * @brief Free all the memory allocated from an arena.
+ *
+ * @param[in] arena     Arena.
+ */
+void miniopt_arena_reset(option_arena *arena) {
+    arena->used = 0;
+}
+
+/**
+ * @brief Arena allocator function, a free is a no-op.
+ *
+ * @param[in] user      Arena.
+ * @param[in] ptr       nil to allocate, or the memory to free.
+ * @param[in] size      Bytes to allocate, it is 0 to free ptr.
+ *
+ * @return not nil      Allocated memory.
+ * @return nil          The arena is full, or ptr is freed.
+ */
+void *miniopt_arena_alloc_fn(void *user, void *ptr, int size) {
+    if (ptr != nil) return nil;
+    return miniopt_arena_alloc((option_arena *)user, size);
+}
+
+/**
+ * @brief Initialize a fixed-block pool on a caller buffer.
+ *
+ * The blocks are carved from the buffer lazily, so init is O(1).
+ *
+ * @param[out] pool     Pool.
+ * @param[in] buf       Pool buffer.
+ * @param[in] size      Pool buffer size.
+ * @param[in] blockSize Block size, it is rounded up to pointer size.
+ */
+void miniopt_pool_init(option_pool *pool, void *buf, int size, int blockSize) {
+    miniopt_assert(pool != nil);
+    miniopt_assert(buf != nil || size == 0);
+    miniopt_assert(blockSize > 0);
+
+    pool->data = miniopt_align_buf(buf, &size);
+    pool->blockSize = miniopt_align_size(blockSize);
+    pool->blockSum = size / pool->blockSize;
+    pool->used = 0;
+    pool->freeList = nil;
+}
+
+/**
+ * @brief Allocate a block from a pool.
+ *
+ * @param[in] pool      Pool.
+ *
+ * @return not nil      Allocated block.
+ * @return nil          The pool is full.
+ */
+void *miniopt_pool_alloc(option_pool *pool) {
+    void *p = pool->freeList;
+    if (p != nil) {
+        pool->freeList = *(void **)p;
+        return p;
+    }
+    if (pool->used >= pool->blockSum) return nil;
+    return pool->data + pool->blockSize * pool->used++;
+}
+
+/**
+ * @brief Free a block to a pool.
+ *
+ * @param[in] pool      Pool.
+ * @param[in] ptr       Block allocated from the pool.
+ */
+void miniopt_pool_free(option_pool *pool, void *ptr) {
+    *(void **)ptr = pool->freeList;
+    pool->freeList = ptr;
+}
+
+/**
+ * @brief Pool allocator function.
+ *
+ * @param[in] user      Pool.
+ * @param[in] ptr       nil to allocate, or the block to free.
+ * @param[in] size      Bytes to allocate, it is 0 to free ptr.
+ *
+ * @return not nil      Allocated block.
+ * @return nil          Size is more than the block size, the pool is full,
+ *                      or ptr is freed.
+ */
+void *miniopt_pool_alloc_fn(void *user, void *ptr, int size) {
+    option_pool *pool = (option_pool *)user;
+    if (ptr != nil) {
+        miniopt_pool_free(pool, ptr);
+        return nil;
+    }
+    if (size < 0 || size > pool->blockSize) return nil;
+    return miniopt_pool_alloc(pool);
+}
+
+#ifdef USING_MINIOPT_HEAP
+/**
+ * @brief Heap allocator function(malloc and free), see alloc_fn.
+ *
+ * @param[in] user      Not used.
+ * @param[in] ptr       nil to allocate, or the memory to free.
+ * @param[in] size      Bytes to allocate, it is 0 to free ptr.
+ */
+void *miniopt_heap_alloc_fn(void *user, void *ptr, int size) {
+    (void)user;
+    if (ptr != nil) {
+        free(ptr);
+        return nil;
+    }
+    return size > 0 ? malloc((size_t)size) : nil;
+}
+#endif
+
+/**
+ * @brief Set the allocator of an option context.
+ *
+ * @param[in] ctx       Option context.
+ * @param[in] fn        Allocator function, nil for no allocator.
+ * @param[in] user      User data of the allocator function.
+ */
+void miniopt_ctx_setalloc(option_context *ctx, alloc_fn fn, void *user) {
+    ctx->alloc.fn = fn;
+    ctx->alloc.user = user;
+}
+
+/**
+ * @brief Set an arena as the allocator of an option context.
+ *
+ * @param[in] ctx       Option context.
+ * @param[in] arena     Arena, nil for no allocator.
+ */
+void miniopt_ctx_setarena(option_context *ctx, option_arena *arena) {
+    miniopt_ctx_setalloc(ctx, arena ? miniopt_arena_alloc_fn : nil, arena);
+}
+
+/**
+ * @brief Allocate by the context allocator.
+ *
+ * @param[in] ctx       Option context.
+ * @param[in] size      Bytes to allocate.
+ *
+ * @return not nil      Allocated memory.
+ * @return nil          No allocator, or it cannot allocate.
+ */
+void *miniopt_ctx_alloc(option_context *ctx, int size) {
+    if (ctx->alloc.fn == nil) return nil;
+    return ctx->alloc.fn(ctx->alloc.user, nil, size);
+}
+
+/**
+ * @brief Free by the context allocator.
+ *
+ * @param[in] ctx       Option context.
+ * @param[in] ptr       Memory allocated by miniopt_ctx_alloc().
+ */
+void miniopt_ctx_free(option_context *ctx, void *ptr) {
+    if (ctx->alloc.fn != nil && ptr != nil) {
+        ctx->alloc.fn(ctx->alloc.user, ptr, 0);
+    }
+}
+
+/**
+ * @brief Free the list value nodes.
+ *
+ * @param[in] ctx       Option context.
+ */
+void miniopt_free_lists(option_context *ctx) {
+    while (ctx->last != nil) {
+        option_list_node *node = ctx->last;
+        ctx->last = node->prev;
+        miniopt_ctx_free(ctx, node);
+    }
+}
+
+/**
+ * @brief Free the subcommand spec, the caller storage is only released.
+ *
+ * @param[in] ctx       Option context.
+ */
+void miniopt_free_subspec(option_context *ctx) {
+    if (ctx->subspec == nil) return;
+    miniopt_spec_release(ctx->subspec);
+    miniopt_ctx_free(ctx, ctx->subspecMem);
+    ctx->subspecMem = nil;
+    ctx->subspec = nil;
+}
+
+/**
+ * @brief Release the resources of an option context.
+ * 
+ * The response files are unmapped, so the args from them cannot be used
+ * any more. The list value nodes and env values of a stopped parse are
+ * freed.
+ * 
+ * @param[in] ctx       Option context.
+ */
+void miniopt_ctx_release(option_context *ctx) {
+    miniopt_free_lists(ctx);
+    miniopt_ctx_free(ctx, (void *)ctx->fallbacks);
+    ctx->fallbacks = nil;
+    miniopt_free_subspec(ctx);
+#ifdef USING_MINIOPT_MMAP
+    for (int i = 0; i < ctx->mapsum; ++i) {
+        munmap(ctx->maps[i].data, ctx->maps[i].mapsize);
+    }
+    ctx->mapsum = 0;
+    ctx->rspIt = nil;
+    ctx->rspEnd = nil;
+    ctx->configIt = nil;
+#endif
+}
+
+/**
+ * @brief Get char class of a token char.
+ * 
+ * @param[in] c     Input char.
+ * 
+ * @return int      A token_char_class.
+ */
+int miniopt_char_class(char c) {
+    if (c == '\0') return char_nul;
+    if (c == '-') return char_dash;
+    if (c == '=') return char_equal;
+    return char_other;
+}
+
+/**
+ * @brief Run the token DFA to find what the token is.
+ * 
+ * @param[in] token     Input token.
+ * 
+ * @return int          An action of token_dfa.
+ */
+int miniopt_token_action(const char *token) {
+    int state = token_begin;
+    while (state < token_state_sum) {
+        state = token_dfa_table[state][miniopt_char_class(*token++)];
+    }
+    return state;
+}
+
+/**
+ * @brief Get the argument of an option has argument.
+ * 
+ * @param[in] ctx               Option context.
+ * @param[in] arg               The argument follows the option name in the
+ *                              token, it is nil if the token ends.
+ * @param[in] argsize           Size of the arg, it is -1 if unknown.
+ * 
+ * @return MINIOPT_PASS         Get argument pass.
+ * @return MINIOPT_ERROR        Argument is missing.
+ */
+int miniopt_get_opt_arg(option_context *ctx, const char *arg, int argsize) {
+    if (arg != nil) {
+        if (*arg != '\0') {
+            ctx->optarg = arg;
+            ctx->optargsize = argsize;
+            return MINIOPT_PASS;
+        }
+    } else if (miniopt_peek_next_token(ctx) != nil) {
+        // "-x arg" or "--key arg"
+        option_view view = miniopt_get_next_token(ctx);
+        ctx->optarg = view.data;
+        ctx->optargsize = view.size;
+        return MINIOPT_PASS;
+    } else if (ctx->state == state_error) {
+        return MINIOPT_ERROR;   // Cannot read the next token.
+    }
+
+    miniopt_make_error(ctx, MINIOPT_ERR_MISSING_ARGUMENT, ctx->argind,
+                       ctx->optind, ctx->token);
+    return MINIOPT_ERROR;
+}
+
+/**
+ * @brief Get next option, bound or not.
+ * 
+ * It is a loop over the context states, the token DFA decides what a new
+ * token is, so the work per token is bounded and there is no recursion.
+ *
+ * @param[in] ctx               Option context.
+ *
+ * @return MINIOPT_PASS         Get next option pass.
+ * @return MINIOPT_FINISHED     Work finished ok(no more option to get).
+ * @return MINIOPT_ERROR        Work finished or stopped with error.
+ */
+int miniopt_ctx_next_opt(option_context *ctx) {
+    const option_spec *spec = ctx->spec;
+    int needArg;
+    int optind;
+
+    for (;;) {
+        switch (ctx->state) {
+            case state_start: {
+                option_view view = miniopt_get_next_token(ctx);
+                const char *token = view.data;
+                if (token == nil) {
+                    if (ctx->state == state_error) continue;
+                    ctx->state = state_finished;
+                    return MINIOPT_FINISHED;
+                }
+                ctx->token = token;
+                ctx->argind = ctx->index;
+                ctx->optname.data = nil;
+                ctx->optname.size = 0;
+
+                switch (miniopt_token_action(token)) {
+                    case action_empty:
+                        // Empty string, just skip it.
+                        continue;
+                    case action_non_opt:
+                        ctx->optind = spec->optsum;
+                        ctx->optarg = token;
+                        ctx->optargsize = view.size;
+                        return MINIOPT_PASS;
+                    case action_marker:
+                        // Option is "--", it is non-option-argument marker.
+                        ctx->state = state_double_dash;
+                        continue;
+                    case action_short_opt:
+                        if (!miniopt_is_short_option(spec, token[1], &needArg,
+                                                     &optind)) {
+                            break;
+                        }
+                        ctx->optind = optind;
+                        ctx->optname.data = &token[1];
+                        ctx->optname.size = 1;
+                        if (needArg) {
+                            // "-xarg", "-x=arg" or "-x arg"
+                            const char *arg = nil;
+                            int argsize = -1;
+                            if (token[2] != '\0') {
+                                int skip = token[2] == '=' ? 3 : 2;
+                                arg = &token[skip];
+                                if (view.size >= 0) argsize = view.size - skip;
+                            }
+                            return miniopt_get_opt_arg(ctx, arg, argsize);
+                        }
+                        // (All) short option has no arg.
+                        // "-abc" equal to "-a -b -c", run into this state to
+                        // split it.
+                        ctx->optarg = nil;
+                        ctx->it = &token[1];
+                        ctx->state = state_short_opt_no_arg;
+                        return MINIOPT_PASS;
+                    case action_long_opt: {
+                        const char *beg = &token[2];
+                        const char *end = beg;
+                        // Long option cannot begin with '=' or '-';
+                        if (*beg != '=' && *beg != '-') {
+                            ++end;
+                            while (*end != '\0' && *end != '=') { ++end; }
+                        }
+                        if (!miniopt_is_long_option(spec, beg, end, &needArg,
+                                                    &optind)) {
+#ifdef USING_MINIOPT_ABBREV
+                            int found = miniopt_find_abbrev(spec, beg, end,
+                                                            &needArg, &optind);
+                            if (found < 0) {
+                                miniopt_make_error(
+                                    ctx, MINIOPT_ERR_AMBIGUOUS_OPTION,
+                                    ctx->argind, spec->optsum, token);
+                                return MINIOPT_ERROR;
+                            }
+                            if (found == 0) break;
+#else
+                            break;
+#endif
+                        }
+                        ctx->optind = optind;
+                        ctx->optname.data = beg;
+                        ctx->optname.size = (int)(end - beg);
+                        if (needArg) {
+                            // "--key=value" or "--key value"
+                            if (*end == '\0') {
+                                return miniopt_get_opt_arg(ctx, nil, -1);
+                            }
+                            int argsize = -1;
+                            if (view.size >= 0) {
+                                argsize = view.size - (int)(end + 1 - token);
+                            }
+                            return miniopt_get_opt_arg(ctx, end + 1, argsize);
+                        }
+                        if (*end != '\0') break;
+                        // option like "--key" has no arg.
+                        ctx->optarg = nil;
+                        return MINIOPT_PASS;
+                    }
+                    default:
+                        break;
+                }
+
+                // Token begin with '-', but it is not an option.
+                miniopt_make_error(ctx, MINIOPT_ERR_UNKNOWN_OPTION,
+                                   ctx->argind, spec->optsum, token);
+                return MINIOPT_ERROR;
+            }
+            case state_double_dash: {
+                // All the tokens are non-option-argument;
+                option_view view = miniopt_get_next_token(ctx);
+                if (view.data == nil) {
+                    if (ctx->state == state_error) continue;
+                    ctx->state = state_finished;
+                    return MINIOPT_FINISHED;
+                }
+                ctx->argind = ctx->index;
+                ctx->optarg = view.data;
+                ctx->optargsize = view.size;
+                ctx->optname.data = nil;
+                ctx->optname.size = 0;
+                ctx->optind = spec->optsum;
+                return MINIOPT_PASS;
+            }
+            case state_short_opt_no_arg: {
+                // split "-abc" to "-a -b -c".
+                if (*(++ctx->it) == '\0') {
+                    // Restart.
+                    ctx->state = state_start;
+                    continue;
+                }
+                if (!miniopt_is_short_option(spec, *(ctx->it), &needArg,
+                                             &optind)) {
+                    optind = spec->optsum;
+                } else if (needArg == 0) {
+                    ctx->optind = optind;
+                    ctx->optarg = nil;
+                    ctx->optname.data = ctx->it;
+                    ctx->optname.size = 1;
+                    return MINIOPT_PASS;
+                }
+                miniopt_make_error(ctx, MINIOPT_ERR_SHORT_GROUP, ctx->argind,
+                                   optind, ctx->token);
+                return MINIOPT_ERROR;
+            }
+            case state_error:
+                ctx->optind = spec->optsum;
+                ctx->optarg = nil;
+                ctx->optname.data = nil;
+                ctx->optname.size = 0;
+                return MINIOPT_ERROR;
+            case state_finished:
+            default:
+                ctx->optind = spec->optsum;
+                ctx->optarg = nil;
+                ctx->optname.data = nil;
+                ctx->optname.size = 0;
+                return MINIOPT_FINISHED;
+        }
+    }
+}
+
+/**
+ * @brief Get current argument, which is kept after next tokens.
+ * 
+ * The argument of a token source is copied by the allocator, because the
+ * source buffer is reused by the tokens after it. An argument of argv is
+ * got as it is.
+ * 
+ * @param[in] ctx               Option context.
+ * @param[out] value            Current argument, or its copy.
+ * 
+ * @return MINIOPT_PASS         Get pass.
+ * @return MINIOPT_ERROR        No allocator, or it cannot allocate.
+ */
+int miniopt_keep_optarg(option_context *ctx, const char **value) {
+    *value = ctx->optarg;
+    if (ctx->source == nil || ctx->optarg == nil) return MINIOPT_PASS;
+
+    option_view view = miniopt_ctx_optarg_view(ctx);
+    char *copy = (char *)miniopt_ctx_alloc(ctx, view.size + 1);
+    if (copy == nil) {
+        miniopt_make_error(ctx, MINIOPT_ERR_NO_MEMORY, ctx->argind,
+                           ctx->optind, nil);
+        return MINIOPT_ERROR;
+    }
+    for (int i = 0; i < view.size; ++i) copy[i] = view.data[i];
+    copy[view.size] = '\0';
+    *value = copy;
+    return MINIOPT_PASS;
+}
+
+/**
+ * @brief Append current option argument to the list value nodes.
+ * 
+ * @param[in] ctx               Option context.
+ * 
+ * @return MINIOPT_PASS         Append pass.
+ * @return MINIOPT_ERROR        No allocator, or it cannot allocate.
+ */
+int miniopt_store_list(option_context *ctx) {
+    const char *value;
+    if (miniopt_keep_optarg(ctx, &value) != MINIOPT_PASS) return MINIOPT_ERROR;
+    option_list_node *node = (option_list_node *)miniopt_ctx_alloc(
+        ctx, (int)sizeof(option_list_node));
+    if (node == nil) {
+        miniopt_ctx_free(ctx, (void *)value);
+        miniopt_make_error(ctx, MINIOPT_ERR_NO_MEMORY, ctx->argind,
+                           ctx->optind, nil);
+        return MINIOPT_ERROR;
+    }
+
+    node->value = value;
+    node->optind = ctx->optind;
+    node->prev = ctx->last;
+    ctx->last = node;
+    return MINIOPT_PASS;
+}
+
+/**
+ * @brief Make each list option values contiguous when parsing finishes.
+ * 
+ * The nodes are counted per list, then each list gets one array from the
+ * allocator and the nodes are walked back to fill the arrays from their
+ * ends, so the values keep argv order. It is O(optsum + value sum), the
+ * nodes are freed at last.
+ * 
+ * @param[in] ctx               Option context.
+ * 
+ * @return MINIOPT_FINISHED     Lists are finished.
+ * @return MINIOPT_ERROR        The allocator cannot allocate.
+ */
+int miniopt_finish_lists(option_context *ctx) {
+    const option_spec *spec = ctx->spec;
+    if (ctx->listDone) return MINIOPT_FINISHED;
+    ctx->listDone = 1;
+
+    for (int i = 0; i < spec->optsum; ++i) {
+        if (spec->opts[i].kind != MINIOPT_KIND_LIST) continue;
+        option_list *list = (option_list *)spec->opts[i].dest;
+        list->items = nil;
+        list->size = 0;
+    }
+    for (option_list_node *node = ctx->last; node; node = node->prev) {
+        ++((option_list *)spec->opts[node->optind].dest)->size;
+    }
+    for (int i = 0; i < spec->optsum; ++i) {
+        if (spec->opts[i].kind != MINIOPT_KIND_LIST) continue;
+        option_list *list = (option_list *)spec->opts[i].dest;
+        if (list->size == 0) continue;
+        list->items = (const char **)miniopt_ctx_alloc(
+            ctx, list->size * (int)sizeof(const char *));
+        if (list->items == nil) {
+            miniopt_make_error(ctx, MINIOPT_ERR_NO_MEMORY, -1, i, nil);
+            return MINIOPT_ERROR;
+        }
+        list->items += list->size;  // Filled from the end.
+    }
+    for (option_list_node *node = ctx->last; node; node = node->prev) {
+        option_list *list = (option_list *)spec->opts[node->optind].dest;
+        *--list->items = node->value;
+    }
+    miniopt_free_lists(ctx);
+    return MINIOPT_FINISHED;
+}
+
+/**
+ * @brief Store current option into its bound destination.
+ * 
+ * @param[in] ctx               Option context.
+ * @param[in] opt               Current option, it is bound.
+ * 
+ * @return MINIOPT_PASS         Store pass.
+ * @return MINIOPT_ERROR        Argument cannot be converted or callback fails.
+ */
+int miniopt_store_opt(option_context *ctx, const option *opt) {
+    switch (opt->kind) {
+        case MINIOPT_KIND_FLAG:
+            *(int *)opt->dest = 1;
+            return MINIOPT_PASS;
+        case MINIOPT_KIND_COUNTER:
+            ++*(int *)opt->dest;
+            return MINIOPT_PASS;
+        case MINIOPT_KIND_STRING:
+            return miniopt_keep_optarg(ctx, (const char **)opt->dest);
+        case MINIOPT_KIND_INT:
+            return miniopt_ctx_int(ctx, -9223372036854775807LL - 1,
+                                   9223372036854775807LL,
+                                   (long long *)opt->dest);
+        case MINIOPT_KIND_CALLBACK: {
+            const option_callback *cb = (const option_callback *)opt->dest;
+            if (cb->fn(cb->user, ctx) == MINIOPT_PASS) return MINIOPT_PASS;
+            if (ctx->state != state_error) {
+                miniopt_make_error(ctx, MINIOPT_ERR_BAD_VALUE, ctx->argind,
+                                   ctx->optind, ctx->optarg);
+            }
+            return MINIOPT_ERROR;
+        }
+        case MINIOPT_KIND_LIST:
+            return miniopt_store_list(ctx);
+        default:
+            return MINIOPT_PASS;
+    }
+}
+
+/**
+ * @brief Get the first set bit of a bitset.
+ * 
+ * @param[in] bits      Bitset of RULE_WORD_SIZE words.
+ * 
+ * @return int >= 0     Bit index.
+ * @return -1           No bit is set.
+ */
+int miniopt_first_bit(const unsigned long long *bits) {
+    for (int i = 0; i < RULE_WORD_SIZE; ++i) {
+        unsigned long long w = bits[i];
+        if (w == 0) continue;
+        int n = i * 64;
+        while ((w & 1) == 0) {
+            w >>= 1;
+            ++n;
+        }
+        return n;
+    }
+    return -1;
+}
+
+/**
+ * @brief Check option rules for an option has been got.
+ * 
+ * @param[in] ctx               Option context.
+ * 
+ * @return MINIOPT_PASS         Check pass.
+ * @return MINIOPT_ERROR        Option cannot be used with a seen option.
+ */
+int miniopt_check_excludes(option_context *ctx) {
+    const option_spec *spec = ctx->spec;
+    int i = miniopt_rule_bit(spec, ctx->optind);
+    if (i < 0) return MINIOPT_PASS;
+
+    unsigned long long hit[RULE_WORD_SIZE];
+    unsigned long long any = 0;
+    for (int k = 0; k < RULE_WORD_SIZE; ++k) {
+        hit[k] = spec->excludes[i][k] & ctx->seen[k];
+        any |= hit[k];
+    }
+    ctx->seen[i / 64] |= 1ull << (i % 64);
+    if (any == 0) return MINIOPT_PASS;
+
+    miniopt_make_error(ctx, MINIOPT_ERR_EXCLUSIVE, ctx->argind, ctx->optind,
+                       nil);
+    ctx->err.other = spec->ruleOptinds[miniopt_first_bit(hit)];
+    return MINIOPT_ERROR;
+}
+
+/**
+ * @brief Check required and requires rules when parsing finishes.
+ * 
+ * @param[in] ctx               Option context.
+ * 
+ * @return MINIOPT_FINISHED     Check pass.
+ * @return MINIOPT_ERROR        An option is missing.
+ */
+int miniopt_check_needs(option_context *ctx) {
+    const option_spec *spec = ctx->spec;
+    unsigned long long hit[RULE_WORD_SIZE];
+    unsigned long long any = 0;
+
+    for (int k = 0; k < RULE_WORD_SIZE; ++k) {
+        hit[k] = spec->required[k] & ~ctx->seen[k];
+        any |= hit[k];
+    }
+    if (any != 0) {
+        miniopt_make_error(ctx, MINIOPT_ERR_REQUIRED, -1,
+                           spec->ruleOptinds[miniopt_first_bit(hit)], nil);
+        return MINIOPT_ERROR;
+    }
+
+    for (int k = 0; k < RULE_WORD_SIZE; ++k) {
+        unsigned long long w = spec->needing[k] & ctx->seen[k];
+        for (int i = k * 64; w != 0; ++i, w >>= 1) {
+            if ((w & 1) == 0) continue;
+            for (int n = 0; n < RULE_WORD_SIZE; ++n) {
+                hit[n] = spec->needs[i][n] & ~ctx->seen[n];
+                any |= hit[n];
+            }
+            if (any != 0) {
+                miniopt_make_error(ctx, MINIOPT_ERR_REQUIRES, -1,
+                                   spec->ruleOptinds[i], nil);
+                ctx->err.other = spec->ruleOptinds[miniopt_first_bit(hit)];
+                return MINIOPT_ERROR;
+            }
+        }
+    }
+    return MINIOPT_FINISHED;
+}
+
+/**
+ * @brief Get the fallback value array of config and env values.
+ *
+ * It is allocated at the first use, one value for each option.
+ *
+ * @param[in] ctx               Option context.
+ *
+ * @return MINIOPT_PASS         Pass.
+ * @return MINIOPT_ERROR        The allocator cannot allocate.
+ */
+int miniopt_alloc_fallbacks(option_context *ctx) {
+    const option_spec *spec = ctx->spec;
+    if (ctx->fallbacks != nil) return MINIOPT_PASS;
+
+    const char **values = (const char **)miniopt_ctx_alloc(
+        ctx, spec->optsum * (int)sizeof(const char *));
+    if (values == nil) {
+        miniopt_make_error(ctx, MINIOPT_ERR_NO_MEMORY, -1, spec->optsum, nil);
+        return MINIOPT_ERROR;
+    }
+    for (int i = 0; i < spec->optsum; ++i) values[i] = nil;
+    ctx->fallbacks = values;
+    ctx->fallbackNext = 0;
+    return MINIOPT_PASS;
+}
+
+/**
+ * @brief Fill the options not given by argv from environment variables.
+ *
+ * It is O(env size + optsum): each env entry is hashed once, there is no
+ * getenv scan for each option. An env value replaces a config value.
+ *
+ * @param[in] ctx       Option context.
+ * @param[in] envp      Environment variables("KEY=value"), nil terminated.
+ * @param[in] prefix    Name prefix of the env names, it can be nil.
+ *
+ * @return MINIOPT_PASS     Scan pass.
+ * @return MINIOPT_ERROR    The allocator cannot allocate.
+ */
+int miniopt_ctx_setenv(option_context *ctx, char **envp, const char *prefix) {
+    const option_spec *spec = ctx->spec;
+    ctx->envp = envp;   // Scanned again for a subcommand.
+    ctx->envprefix = prefix;
+    if (!spec->envIndexed || envp == nil) return MINIOPT_PASS;
+    if (miniopt_alloc_fallbacks(ctx) != MINIOPT_PASS) return MINIOPT_ERROR;
+
+    int n = 0;
+    while (envp[n] != nil) ++n;
+
+    // Walk back, so the first entry of a name is set at last like getenv.
+    const unsigned int mask = spec->envMask;
+    while (n-- > 0) {
+        const char *beg = envp[n];
+        const char *p = prefix;
+        while (p && *p && *beg == *p) {
+            ++beg;
+            ++p;
+        }
+        if (p && *p) continue;
+
+        const char *end = beg;
+        while (*end && *end != '=') ++end;
+        if (*end != '=' || end == beg) continue;
+
+        unsigned int slot = miniopt_hash(beg, end) & mask;
+        int i;
+        while ((i = spec->envIndex[slot]) >= 0) {
+            if (miniopt_is_same(beg, end, spec->opts[i].env)) {
+                ctx->fallbacks[i] = end + 1;
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+    }
+    return MINIOPT_PASS;
+}
+
+#ifdef USING_MINIOPT_MMAP
+/**
+ * @brief Make a config file error at a line.
+ *
+ * @param[in] ctx       Option context.
+ * @param[in] code      Error code.
+ * @param[in] path      Config file path.
+ * @param[in] line      Line number.
+ * @param[in] token     The token, it can be nil.
+ */
+void miniopt_make_config_error(option_context *ctx, option_errc code,
+                               const char *path, int line,
+                               const char *token) {
+    miniopt_make_error(ctx, code, -1, ctx->spec->optsum, token);
+    ctx->err.file = path;
+    ctx->err.line = line;
+}
+
+/**
+ * @brief Trim the spaces of a string range.
+ */
+void miniopt_trim(char **beg, char **end) {
+    while (*beg < *end && (**beg == ' ' || **beg == '\t')) ++*beg;
+    while (*end > *beg && ((*end)[-1] == ' ' || (*end)[-1] == '\t' ||
+                           (*end)[-1] == '\r')) {
+        --*end;
+    }
+}
+
+/**
+ * @brief Check whether a config line is a "[name]" section line.
+ *
+ * @param[in] beg       Trimmed line begin.
+ * @param[in] end       Trimmed line end.
+ * @param[in] name      Section name to match, nil to match any section.
+ *
+ * @return 1            It is a section line(of name).
+ * @return 0            It is not.
+ */
+int miniopt_is_section(const char *beg, const char *end, const char *name) {
+    if (end - beg < 2 || *beg != '[' || end[-1] != ']') return 0;
+    return name == nil || miniopt_is_same(beg + 1, end - 1, name);
+}
+
+/**
+ * @brief Parse the "key = value" lines of a config file range.
+ *
+ * The lines are walked once, the keys are resolved by the same long name
+ * lookup as "--key", the values are terminated in place(the mapping is
+ * private and has a zero byte after the file), so no line is copied. The
+ * lines of other sections are skipped without being changed.
+ *
+ * @param[in] ctx       Option context.
+ * @param[in] section   Subcommand name, nil for the lines before the first
+ *                      section, where ctx->configIt is set.
+ *
+ * @return MINIOPT_PASS     Parse pass.
+ * @return MINIOPT_ERROR    A line is wrong, or the allocator cannot
+ *                          allocate.
+ */
+int miniopt_read_config(option_context *ctx, const char *section) {
+    const option_spec *spec = ctx->spec;
+    const char *path = ctx->configPath;
+    if (miniopt_alloc_fallbacks(ctx) != MINIOPT_PASS) return MINIOPT_ERROR;
+
+    char *it = ctx->configIt;
+    char *end = ctx->configEnd;
+    int inside = section == nil;
+    ctx->configIt = nil;
+    for (int line = ctx->configLine; it < end; ++line) {
+        char *beg = it;
+        while (it < end && *it != '\n') ++it;
+        char *lineEnd = it;
+        if (it < end) ++it;
+
+        miniopt_trim(&beg, &lineEnd);
+        if (beg == lineEnd || *beg == '#' || *beg == ';') continue;
+        if (miniopt_is_section(beg, lineEnd, nil)) {
+            if (section == nil) {
+                ctx->configIt = beg;    // Kept for the subcommand.
+                ctx->configLine = line;
+                return MINIOPT_PASS;
+            }
+            if (inside) return MINIOPT_PASS;
+            inside = miniopt_is_section(beg, lineEnd, section);
+            continue;
+        }
+        if (!inside) continue;
+
+        char *eq = beg;
+        while (eq < lineEnd && *eq != '=') ++eq;
+        char *key = beg;
+        char *keyEnd = eq;
+        miniopt_trim(&key, &keyEnd);
+        if (eq == lineEnd || key == keyEnd) {
+            miniopt_make_config_error(ctx, MINIOPT_ERR_CONFIG_SYNTAX, path,
+                                      line, nil);
+            return MINIOPT_ERROR;
+        }
+
+        int hasArg;
+        int optind;
+        if (!miniopt_is_long_option(spec, key, keyEnd, &hasArg, &optind)) {
+            *keyEnd = '\0';
+            miniopt_make_config_error(ctx, MINIOPT_ERR_UNKNOWN_OPTION, path,
+                                      line, key);
+            return MINIOPT_ERROR;
+        }
+
+        char *value = eq + 1;
+        char *valueEnd = lineEnd;
+        miniopt_trim(&value, &valueEnd);
+        if (valueEnd - value >= 2 && *value == '"' && valueEnd[-1] == '"') {
+            ++value;
+            --valueEnd;
+        }
+        *valueEnd = '\0';   // A space, '"', '\n' or the zero byte.
+        ctx->fallbacks[optind] = value;
+    }
+    return MINIOPT_PASS;
+}
+
+/**
+ * @brief Fill the options not given by env or argv from a config file.
+ *
+ * The lines before the first section are parsed now, the sections are kept
+ * for the subcommand, see miniopt_read_config().
+ *
+ * @param[in] ctx       Option context.
+ * @param[in] path      Config file path.
+ *
+ * @return MINIOPT_PASS     Parse pass.
+ * @return MINIOPT_ERROR    The file cannot be read, a line is wrong, or the
+ *                          allocator cannot allocate.
+ */
+int miniopt_ctx_setconfig(option_context *ctx, const char *path) {
+    if (ctx->mapsum >= RESPONSE_FILE_MAX_SIZE ||
+        miniopt_map_file(path, &ctx->maps[ctx->mapsum]) != 0) {
+        miniopt_make_config_error(ctx, MINIOPT_ERR_CONFIG_READ, path, 0,
+                                  path);
+        return MINIOPT_ERROR;
+    }
+    option_map *map = &ctx->maps[ctx->mapsum++];
+    ctx->configPath = path;
+    ctx->configIt = map->data;
+    ctx->configEnd = map->data + map->size;
+    ctx->configLine = 1;
+    return miniopt_read_config(ctx, nil);
+}
+#endif
+
+/**
+ * @brief Check whether a value of an option has no argument is false.
+ */
+int miniopt_is_false(const char *value) {
+    const char *end = value + miniopt_strlen(value);
+    return value == end || miniopt_is_same(value, end, "0") ||
+           miniopt_is_same(value, end, "false") ||
+           miniopt_is_same(value, end, "no");
+}
+
+/**
+ * @brief Deliver next config or env value of an option not given by argv.
+ *
+ * @param[in] ctx               Option context.
+ *
+ * @return MINIOPT_PASS         A value is delivered as current option.
+ * @return MINIOPT_FINISHED     No more value.
+ */
+int miniopt_next_fallback(option_context *ctx) {
+    const option_spec *spec = ctx->spec;
+    while (ctx->fallbackNext < spec->optsum) {
+        int i = ctx->fallbackNext++;
+        const char *value = ctx->fallbacks[i];
+        if (value == nil) continue;
+        ctx->fallbacks[i] = nil;
+
+        const option *opt = &spec->opts[i];
+        if (!miniopt_opt_has_arg(opt)) {
+            if (miniopt_is_false(value)) continue;
+            value = nil;
+        }
+        const char *name = opt->lname ? opt->lname : opt->env;
+        ctx->optind = i;
+        ctx->optarg = value;
+        ctx->optargsize = -1;
+        ctx->optname.data = name;
+        ctx->optname.size = miniopt_strlen(name);
+        ctx->argind = -1;
+        return MINIOPT_PASS;
+    }
+    miniopt_ctx_free(ctx, (void *)ctx->fallbacks);
+    ctx->fallbacks = nil;
     return MINIOPT_FINISHED;
 }
 
 /**
- * @brief Get current option index to the option array.
- *
- * It should be used after (miniopt.getopt() > 0);
- *
- * Here optsum means sum-of-the-option-array or option-array-size.
- *
- * @return [0, optsum-1]    An option index to the option array.
- * @return optsum           It means miniopt.optarg() is non option argument.
+ * @brief Switch the context to the pending subcommand.
+ *
+ * The subcommand option array is checked and indexed here, only for the
+ * invoked subcommand, into the storage of miniopt_ctx_setsubspec() or one
+ * from the allocator. The per spec parsing state starts again, the config
+ * section of the subcommand and the env are applied to its options.
+ *
+ * @param[in] ctx               Option context.
+ *
+ * @return MINIOPT_COMMAND      Switch pass.
+ * @return MINIOPT_ERROR        The allocator cannot allocate the spec, the
+ *                              subcommand option array is not valid, or its
+ *                              config section or env cannot be applied.
+ */
+int miniopt_enter_command(option_context *ctx) {
+    const option_command *cmd = &ctx->spec->commands[ctx->command];
+    ctx->commandPending = 0;
+
+    // The allocator aligns to pointer size, the SIMD name slots of a spec are
+    // 32 bytes aligned, so the memory is aligned up.
+    option_spec *sub = ctx->subspecBuf;
+    void *mem = nil;
+    if (sub == nil) {
+        mem = miniopt_ctx_alloc(ctx, (int)sizeof(option_spec) + 31);
+        if (mem != nil) sub = (option_spec *)miniopt_align_up(mem, 32);
+    }
+    if (sub == nil) {
+        miniopt_make_error(ctx, MINIOPT_ERR_NO_MEMORY, -1, ctx->spec->optsum,
+                           nil);
+        return MINIOPT_ERROR;
+    }
+    miniopt_free_subspec(ctx);
+    ctx->subspec = sub;
+    ctx->subspecMem = mem;
+    int status = miniopt_spec_init_alloc(sub, cmd->opts, cmd->optsum,
+                                         cmd->lookup, ctx->alloc.fn,
+                                         ctx->alloc.user);
+    ctx->spec = sub;
+
+    for (int i = 0; i < RULE_WORD_SIZE; ++i) ctx->seen[i] = 0;
+    ctx->listDone = 0;
+    ctx->fallbackNext = 0;
+    if (status != 0) {
+        miniopt_make_error(ctx, MINIOPT_ERR_SPEC, -1, sub->optsum, nil);
+        return MINIOPT_ERROR;
+    }
+#ifdef USING_MINIOPT_MMAP
+    if (ctx->configIt != nil &&
+        miniopt_read_config(ctx, cmd->name) != MINIOPT_PASS) {
+        return MINIOPT_ERROR;
+    }
+#endif
+    if (miniopt_ctx_setenv(ctx, ctx->envp, ctx->envprefix) != MINIOPT_PASS) {
+        return MINIOPT_ERROR;
+    }
+
+    ctx->optind = sub->optsum;
+    ctx->optarg = cmd->name;
+    ctx->optargsize = -1;
+    return MINIOPT_COMMAND;
+}
+
+/**
+ * @brief Get next option.
+ * 
+ * It should be used after miniopt_ctx_init();
+ * 
+ * Bound options(option.kind is not MINIOPT_KIND_NONE) are stored into their
+ * destinations in the same pass, they are not returned. Option rules are
+ * checked in the same pass too, see miniopt_spec_rules(). Env values are
+ * delivered after argv, see miniopt_ctx_setenv(). A subcommand ends the
+ * options(and the env values, lists and rules) of current spec, then the
+ * next options are of the subcommand spec.
+ *
+ * @param[in] ctx               Option context.
+ *
+ * @return MINIOPT_COMMAND      A subcommand is got.
+ * @return MINIOPT_PASS         Get next option pass.
+ * @return MINIOPT_FINISHED     Work finished ok(no more option to get).
+ * @return MINIOPT_ERROR        Work finished or stopped with error.
+ */
+int miniopt_ctx_getopt(option_context *ctx) {
+    const option_spec *spec = ctx->spec;
+    for (;;) {
+        int status;
+        if (ctx->commandPending && ctx->state != state_error) {
+            // A subcommand ends the options of this spec.
+            ctx->optind = spec->optsum;
+            ctx->optarg = nil;
+            ctx->optname.data = nil;
+            ctx->optname.size = 0;
+            status = MINIOPT_FINISHED;
+        } else {
+            status = miniopt_ctx_next_opt(ctx);
+        }
+        if (status == MINIOPT_PASS && ctx->optind >= spec->optsum &&
+            spec->commandsum > 0 && !ctx->commandChecked) {
+            ctx->commandChecked = 1;
+            ctx->command = miniopt_find_command(spec, ctx->optarg);
+            if (ctx->command >= 0) {
+                ctx->commandPending = 1;
+                continue;
+            }
+        }
+        if (ctx->fallbacks != nil) {
+            if (status == MINIOPT_FINISHED) {
+                status = miniopt_next_fallback(ctx);
+            } else if (status == MINIOPT_PASS &&
+                       ctx->optind < spec->optsum) {
+                ctx->fallbacks[ctx->optind] = nil;   // Argv overrides them.
+            }
+        }
+        if (status == MINIOPT_FINISHED && spec->listed) {
+            status = miniopt_finish_lists(ctx);
+        }
+        if (status == MINIOPT_FINISHED && spec->ruled) {
+            status = miniopt_check_needs(ctx);
+        }
+        if (status == MINIOPT_FINISHED && ctx->commandPending) {
+            return miniopt_enter_command(ctx);
+        }
+        if (status != MINIOPT_PASS || ctx->optind >= spec->optsum) {
+            return status;
+        }
+        if (spec->ruled && miniopt_check_excludes(ctx) != MINIOPT_PASS) {
+            return MINIOPT_ERROR;
+        }
+        const option *opt = &spec->opts[ctx->optind];
+        if (opt->kind == MINIOPT_KIND_NONE) return status;
+        if (miniopt_store_opt(ctx, opt) != MINIOPT_PASS) return MINIOPT_ERROR;
+    }
+}
+
+/**
+ * @brief Parse all the args into the result arrays in one pass.
+ * 
+ * It can be used again to continue if the result arrays are full, or
+ * after a subcommand is got to parse the subcommand options.
+ * 
+ * @param[in] ctx               Option context.
+ * @param[out] result           Result arrays.
+ * @param[out] size             Result size has been written.
+ * 
+ * @return MINIOPT_COMMAND      A subcommand is got, see miniopt_ctx_command().
+ * @return MINIOPT_PASS         Result arrays are full, there may be more.
+ * @return MINIOPT_FINISHED     Work finished ok(no more option to get).
+ * @return MINIOPT_ERROR        Work finished or stopped with error.
+ */
+int miniopt_ctx_parseall(option_context *ctx, option_result *result,
+                         int *size) {
+    miniopt_assert(result != nil);
+    miniopt_assert(size != nil);
+
+    int *optind = result->optind;
+    int *argind = result->argind;
+    const char **optarg = result->optarg;
+    const int capacity = result->capacity;
+
+    int status = MINIOPT_PASS;
+    int i = 0;
+    while (i < capacity &&
+           (status = miniopt_ctx_getopt(ctx)) == MINIOPT_PASS) {
+        if (miniopt_keep_optarg(ctx, &optarg[i]) != MINIOPT_PASS) {
+            status = MINIOPT_ERROR;
+            break;
+        }
+        optind[i] = ctx->optind;
+        argind[i] = ctx->argind;
+        ++i;
+    }
+
+    *size = i;
+    return status;
+}
+
+/**
+ * @brief Get current option index to the option array.
+ *
+ * It should be used after (miniopt_ctx_getopt() > 0);
+ *
+ * Here optsum means sum-of-the-option-array or option-array-size.
+ *
+ * @param[in] ctx           Option context.
+ *
+ * @return [0, optsum-1]    An option index to the option array.
+ * @return optsum           It means optarg is non option argument.
+ */
+int miniopt_ctx_optind(const option_context *ctx) {
+    return ctx->optind;
+}
+
+/**
+ * @brief Get current subcommand index.
+ *
+ * It can be used after miniopt_ctx_getopt() returns MINIOPT_COMMAND, then
+ * the option indexes are of the subcommand option array.
+ *
+ * @param[in] ctx           Option context.
+ *
+ * @return [0, cmdsum-1]    Subcommand index to the subcommand array.
+ * @return -1               No subcommand is got.
+ */
+int miniopt_ctx_command(const option_context *ctx) {
+    return ctx->command;
+}
+
+/**
+ * @brief Set the storage of the subcommand spec.
+ *
+ * @param[in] ctx       Option context.
+ * @param[in] subspec   Subcommand spec storage, nil to use the allocator.
+ */
+void miniopt_ctx_setsubspec(option_context *ctx, option_spec *subspec) {
+    miniopt_free_subspec(ctx);
+    ctx->subspecBuf = subspec;
+}
+
+/**
+ * @brief Get current option-argument or non-option-argument.
+ *
+ * It should be used after (miniopt_ctx_getopt() > 0);
+ *
+ * @param[in] ctx      Option context.
+ *
+ * @return not nil     An argument.
+ * @return nil         Current option has no argument.
+ */
+const char *miniopt_ctx_optarg(const option_context *ctx) { 
+    return ctx->optarg; 
+}
+
+/**
+ * @brief Get current argument as a string view.
+ *
+ * The size is known without scanning if the token comes from a token source
+ * or a response file, else it is computed once and cached.
+ *
+ * @param[in] ctx      Option context.
+ *
+ * @return option_view      The argument, its data is nil if current option has
+ *                          no argument.
+ */
+option_view miniopt_ctx_optarg_view(option_context *ctx) {
+    option_view view = {ctx->optarg, 0};
+    if (ctx->optarg != nil) {
+        if (ctx->optargsize < 0) {
+            ctx->optargsize = miniopt_strlen(ctx->optarg);
+        }
+        view.size = ctx->optargsize;
+    }
+    return view;
+}
+
+/**
+ * @brief Get current option name as a string view.
+ *
+ * The name is not terminated by '\0', it points into the token.
+ *
+ * @param[in] ctx      Option context.
+ *
+ * @return option_view      Short name(size 1) or long name, its data is nil
+ *                          if current result is not an option.
+ */
+option_view miniopt_ctx_optname_view(const option_context *ctx) {
+    return ctx->optname;
+}
+
+/**
+ * @brief Get the name prefix of an option in messages.
+ * 
+ * @param[in] opt       Option.
+ * @param[out] name     Buffer of 3 chars for a short name.
+ * 
+ * @return "--"         Option has a long name, it follows the prefix.
+ * @return name         Short name "-c".
+ */
+const char *miniopt_display_name(const option *opt, char *name) {
+    if (opt->lname != nil) return "--";
+    name[0] = '-';
+    name[1] = opt->sname;
+    name[2] = '\0';
+    return name;
+}
+
+/**
+ * @brief Format current error into the context error buffer.
+ *
+ * @param[in] ctx      Option context.
+ *
+ * @return not nil     An erro str.
+ * @return nil         No error.
+ */
+const char *miniopt_format_error(option_context *ctx) {
+    // Message parts: prefix, token, suffix.
+    static const char *const messages[MINIOPT_ERR_SUM][2] = {
+        {nil, nil},
+        {nil, nil},
+        {"option ", " is unknown."},
+        {"option ", " argument is missing."},
+        {"option ", " has error."},
+        {"cannot read next token.", nil},
+        {"response file ", " is too many."},
+        {"response file ", " cannot be read."},
+        {"option ", " is ambiguous."},
+        {" argument ", " is not valid."},
+        {" argument ", " is out of range."},
+        {" is required.", nil},
+        {" requires option ", "."},
+        {" cannot be used with option ", "."},
+        {" values cannot be stored.", nil},
+        {"config file ", " cannot be read."},
+        {"line is not \"key = value\".", nil}};
+
+    const option_error *err = &ctx->err;
+    if (ctx->error != nil || err->code == MINIOPT_ERR_NONE) return ctx->error;
+    if (err->code == MINIOPT_ERR_SPEC) {
+        ctx->error = miniopt_spec_what(ctx->spec);
+        return ctx->error;
+    }
+
+    int size;
+    if (err->code >= MINIOPT_ERR_REQUIRED &&
+        err->code <= MINIOPT_ERR_NO_MEMORY) {
+        // "option --a requires option --b.", both are option names, or
+        // "values cannot be stored." without an option.
+        char name[3];
+        const char *suffix = messages[err->code][err->other >= 0];
+        int used = 0;
+        size = 1;
+        if (err->optind < ctx->spec->optsum) {
+            const option *opt = &ctx->spec->opts[err->optind];
+            size = miniopt_concat(ctx->errbuf, ERROR_STR_MAX_SIZE, "option ",
+                                  miniopt_display_name(opt, name), opt->lname);
+        } else {
+            ++suffix;
+        }
+        if (size > 0) used = size - 1;
+        if (size > 0 && err->other >= 0) {
+            const option *opt = &ctx->spec->opts[err->other];
+            size = miniopt_concat(ctx->errbuf + used,
+                                  ERROR_STR_MAX_SIZE - used,
+                                  messages[err->code][0],
+                                  miniopt_display_name(opt, name),
+                                  opt->lname);
+            if (size > 0) used += size - 1;
+        }
+        if (size > 0) {
+            miniopt_concat(ctx->errbuf + used, ERROR_STR_MAX_SIZE - used,
+                           suffix, nil, nil);
+        }
+        ctx->error = ctx->errbuf;
+        return ctx->error;
+    }
+    if (err->code == MINIOPT_ERR_BAD_VALUE ||
+        err->code == MINIOPT_ERR_OUT_OF_RANGE) {
+        // "option --key argument value is not valid.", or "argument value
+        // is not valid." for a non-option-argument.
+        const char *prefix = messages[err->code][0];
+        size = 1;
+        if (err->optind < ctx->spec->optsum) {
+            const option *opt = &ctx->spec->opts[err->optind];
+            char name[3];
+            size = miniopt_concat(ctx->errbuf, ERROR_STR_MAX_SIZE, "option ",
+                                  miniopt_display_name(opt, name), opt->lname);
+        } else {
+            ++prefix;
+        }
+        if (size > 0) {
+            miniopt_concat(ctx->errbuf + size - 1,
+                           ERROR_STR_MAX_SIZE - size + 1, prefix, err->token,
+                           messages[err->code][1]);
+        }
+        ctx->error = ctx->errbuf;
+        return ctx->error;
+    }
+
+    const char *suffix = messages[err->code][1];
+    if (err->code == MINIOPT_ERR_MISSING_ARGUMENT && err->token[0] == '-' &&
+        err->token[1] == '-' && !miniopt_find(err->token, '=')) {
+        suffix = ", argument is missing.";  // "--key" is the last token.
+    }
+    size = miniopt_concat(ctx->errbuf, ERROR_STR_MAX_SIZE,
+                          messages[err->code][0], err->token, suffix);
+    ctx->error = ctx->errbuf;
+
+    int optinds[SUGGEST_MAX_SIZE];
+    int sum = miniopt_ctx_suggest(ctx, optinds, SUGGEST_MAX_SIZE);
+    // " Did you mean --" and "?" are 17 chars, ", --" or " or --" is at
+    // most 6 chars more per name, the names do not fit are dropped.
+    int total = size + 17;
+    int fit = 0;
+    for (; fit < sum; ++fit) {
+        total += miniopt_strlen(ctx->spec->opts[optinds[fit]].lname) +
+                 (fit > 0 ? 6 : 0);
+        if (total > ERROR_STR_MAX_SIZE) break;
+    }
+    for (int i = 0; i < fit && size > 0; ++i) {
+        const char *glue = i == 0 ? " Did you mean --"
+                           : i + 1 == fit ? " or --" : ", --";
+        size += miniopt_concat(ctx->errbuf + size - 1,
+                               ERROR_STR_MAX_SIZE - size + 1, glue,
+                               ctx->spec->opts[optinds[i]].lname,
+                               i + 1 == fit ? "?" : nil) - 1;
+    }
+    return ctx->error;
+}
+
+/**
+ * @brief Get current error str.
+ *
+ * The message is formatted into the context error buffer at the first call,
+ * an error of a config file line begins with "file:line: ".
+ *
+ * @param[in] ctx      Option context.
+ *
+ * @return not nil     An erro str.
+ * @return nil         No error.
+ */
+const char *miniopt_ctx_what(option_context *ctx) {
+    if (ctx->error != nil) return ctx->error;
+    const char *error = miniopt_format_error(ctx);
+    if (error == nil || ctx->err.line <= 0 || error != ctx->errbuf) {
+        return error;
+    }
+
+    // The location is dropped if it does not fit.
+    char message[ERROR_STR_MAX_SIZE];
+    char buf[32];
+    const char *line = miniopt_to_string(buf, sizeof(buf), ctx->err.line);
+    int size = miniopt_strlen(error);
+    if (miniopt_strlen(ctx->err.file) + miniopt_strlen(line) + size + 4 >
+        ERROR_STR_MAX_SIZE) {
+        return error;
+    }
+    for (int i = 0; i <= size; ++i) message[i] = error[i];
+    size = miniopt_concat(ctx->errbuf, ERROR_STR_MAX_SIZE, ctx->err.file, ":",
+                          line);
+    miniopt_concat(ctx->errbuf + size - 1, ERROR_STR_MAX_SIZE - size + 1,
+                   ": ", message, nil);
+    return ctx->error;
+}
+
+/**
+ * @brief Edit distance of a pattern and a text.
+ * 
+ * It is Myers' bit-parallel algorithm(Hyyro's form for the distance of two
+ * whole strings), each text char costs a few word operations.
+ * 
+ * @param[in] peq       Match masks of the pattern, bit i of peq[c] is set if
+ *                      pattern[i] == c.
+ * @param[in] m         Pattern size, it is in [1, 64].
+ * @param[in] text      Text.
+ * @param[in] n         Text size.
+ * @param[in] limit     Max distance wanted, the distance changes at most 1
+ *                      per text char, so it stops when the rest cannot get
+ *                      it back into the limit.
+ * 
+ * @return int >= 0     Edit distance, or limit + 1 if it is more than limit.
+ */
+int miniopt_edit_distance(const unsigned long long *peq, int m,
+                          const char *text, int n, int limit) {
+    const unsigned long long last = 1ull << (m - 1);
+    unsigned long long pv = ~0ull;
+    unsigned long long mv = 0;
+    int score = m;
+
+    for (; *text; ++text) {
+        if (score - n-- > limit) return limit + 1;
+        unsigned long long eq = peq[(unsigned char)*text];
+        unsigned long long xv = eq | mv;
+        unsigned long long xh = (((eq & pv) + pv) ^ pv) | eq;
+        unsigned long long ph = mv | ~(xh | pv);
+        unsigned long long mh = pv & xh;
+        if (ph & last) ++score;
+        if (mh & last) --score;
+        ph = (ph << 1) | 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+    }
+
+    return score;
+}
+
+/**
+ * @brief Count the set bits.
+ */
+int miniopt_popcount(unsigned long long bits) {
+    int sum = 0;
+    for (; bits; bits &= bits - 1) { ++sum; }
+    return sum;
+}
+
+/**
+ * @brief Char signature of a string, bit (c & 63) is set for each char c.
+ * 
+ * @param[in] s         String.
+ * @param[in] max       Max size to scan.
+ * @param[out] size     String size, or max + 1 if it is longer than max.
+ * 
+ * @return              Char signature of the scanned chars.
+ */
+unsigned long long miniopt_char_signature(const char *s, int max, int *size) {
+    unsigned long long bits = 0;
+    int i = 0;
+    for (; i <= max && s[i] != '\0'; ++i) {
+        bits |= 1ull << ((unsigned char)s[i] & 63);
+    }
+    *size = i;
+    return bits;
+}
+
+/**
+ * @brief Suggest the closest long names for an unknown option.
+ * 
+ * It works for "--key" and short option clusters like "-key" or "-vx", the
+ * name part of the token is compared with the long names by edit distance.
+ * A name is skipped before the distance is computed if its size is out of
+ * the distance limit window, or its char signature differs from the token
+ * one in more bits than the limit(each missing or extra char costs at least
+ * one edit). It is not done until it is called, see miniopt_ctx_what().
+ * 
+ * @param[in] ctx           Option context.
+ * @param[out] optinds      Option indexes of the names, the closest first,
+ *                          the same distance names in option order.
+ * @param[in] size          Max names, at most SUGGEST_MAX_SIZE are got.
+ * 
+ * @return int >= 0         Names got, 0 if there is no error to suggest or
+ *                          no long name is close.
+ */
+int miniopt_ctx_suggest(const option_context *ctx, int *optinds, int size) {
+    const option_error *err = &ctx->err;
+    if ((err->code != MINIOPT_ERR_UNKNOWN_OPTION &&
+         err->code != MINIOPT_ERR_SHORT_GROUP) ||
+        err->token == nil || size <= 0) {
+        return 0;
+    }
+
+    // "--key=value" of a known "--key" has no arg, it is not a typo.
+    const char *beg = err->token;
+    int skipSame = (beg[0] == '-' && beg[1] == '-');
+    if (*beg == '-') ++beg;
+    if (*beg == '-') ++beg;
+    int m = 0;
+    while (beg[m] != '\0' && beg[m] != '=') { ++m; }
+    if (m == 0 || m > 64) return 0;
+
+    unsigned long long peq[256] = {0};
+    unsigned long long signature = 0;
+    for (int i = 0; i < m; ++i) {
+        peq[(unsigned char)beg[i]] |= 1ull << i;
+        signature |= 1ull << ((unsigned char)beg[i] & 63);
+    }
+
+    // At most about one edit per 3 chars, and not all the chars.
+    int limit = m / 3 + 1;
+    if (limit >= m) limit = m - 1;
+
+    const option_spec *spec = ctx->spec;
+    int distances[SUGGEST_MAX_SIZE];
+    if (size > SUGGEST_MAX_SIZE) size = SUGGEST_MAX_SIZE;
+    int sum = 0;
+    for (int i = 0; i < spec->optsum && limit >= 0; ++i) {
+        const char *name = spec->opts[i].lname;
+        if (name == nil) continue;
+        int n;
+        unsigned long long bits = miniopt_char_signature(name, m + limit, &n);
+        if (n > m + limit || n < m - limit ||
+            miniopt_popcount(signature & ~bits) > limit ||
+            miniopt_popcount(bits & ~signature) > limit) {
+            continue;
+        }
+        int distance = miniopt_edit_distance(peq, m, name, n, limit);
+        if (distance == 0 && skipSame) return 0;
+        if (distance > limit) continue;
+
+        // Insert it after the names of the same or smaller distance.
+        int j = sum < size ? sum++ : size - 1;
+        for (; j > 0 && distances[j - 1] > distance; --j) {
+            distances[j] = distances[j - 1];
+            optinds[j] = optinds[j - 1];
+        }
+        distances[j] = distance;
+        optinds[j] = i;
+        // Only a closer one replaces the last name when they are full.
+        if (sum == size) limit = distances[size - 1] - 1;
+    }
+
+    return sum;
+}
+
+/**
+ * @brief Get current error.
+ *
+ * @param[in] ctx      Option context.
+ *
+ * @return option_error     Current error, its code is MINIOPT_ERR_NONE if no
+ *                          error.
+ */
+const option_error *miniopt_ctx_error(const option_context *ctx) {
+    return &ctx->err;
+}
+
+/**
+ * @brief Parse an unsigned decimal(or "0x" hex) integer prefix.
+ * 
+ * @param[in] s         Input string.
+ * @param[out] value    Output value.
+ * @param[out] next     The first char not parsed.
+ * 
+ * @return 0            Parse pass.
+ * @return -1           No digit.
+ * @return -2           Overflow.
+ */
+int miniopt_parse_uint(const char *s, unsigned long long *value,
+                       const char **next) {
+    unsigned long long v = 0;
+    unsigned int base = 10;
+    int digits = 0;
+    int overflow = 0;
+
+    if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+        base = 16;
+        s += 2;
+    }
+    for (;; ++s, ++digits) {
+        unsigned int d;
+        if (*s >= '0' && *s <= '9') {
+            d = (unsigned int)(*s - '0');
+        } else if (base == 16 && *s >= 'a' && *s <= 'f') {
+            d = (unsigned int)(*s - 'a' + 10);
+        } else if (base == 16 && *s >= 'A' && *s <= 'F') {
+            d = (unsigned int)(*s - 'A' + 10);
+        } else {
+            break;
+        }
+        if (v > (~0ull - d) / base) overflow = 1;
+        v = v * base + d;
+    }
+
+    *value = v;
+    *next = s;
+    if (digits == 0) return -1;
+    return overflow ? -2 : 0;
+}
+
+/**
+ * @brief Parse a signed integer.
+ * 
+ * @param[in] s         Input string, like "-12" or "0x1f".
+ * @param[out] value    Output value.
+ * 
+ * @return 0            Parse pass.
+ * @return -1           It is not an integer.
+ * @return -2           It is out of the long long range.
+ */
+int miniopt_parse_int(const char *s, long long *value) {
+    int minus = (*s == '-');
+    if (*s == '-' || *s == '+') ++s;
+
+    unsigned long long v;
+    const char *next;
+    int status = miniopt_parse_uint(s, &v, &next);
+    if (status == -1 || *next != '\0') return -1;
+    if (status == -2) return -2;
+
+    const unsigned long long limit = minus ? (1ull << 63) : (1ull << 63) - 1;
+    if (v > limit) return -2;
+    *value = minus ? (long long)(0 - v) : (long long)v;
+    return 0;
+}
+
+/**
+ * @brief Parse a float.
+ * 
+ * It is locale free, the decimal point is always '.'. Up to 19 significant
+ * digits are used, the result is exact if the digits and the exponent are
+ * small(up to 2^53 and 10^22), else it is within a few ulps.
+ * 
+ * @param[in] s         Input string, like "-1.5", ".5" or "2.5e-3".
+ * @param[out] value    Output value.
+ * 
+ * @return 0            Parse pass.
+ * @return -1           It is not a float.
+ * @return -2           It is out of the double range.
+ */
+int miniopt_parse_float(const char *s, double *value) {
+    static const double pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                   1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                   1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                   1e18, 1e19, 1e20, 1e21, 1e22};
+    int minus = (*s == '-');
+    if (*s == '-' || *s == '+') ++s;
+
+    unsigned long long mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    int point = 0;
+    for (;; ++s) {
+        if (*s == '.' && !point) {
+            point = 1;
+        } else if (*s >= '0' && *s <= '9') {
+            ++digits;
+            if (mantissa < 1000000000000000000ull) {
+                mantissa = mantissa * 10 + (unsigned long long)(*s - '0');
+                if (point) --exponent;
+            } else if (!point) {
+                ++exponent;     // Drop the digit.
+            }
+        } else {
+            break;
+        }
+    }
+    if (digits == 0) return -1;
+
+    if (*s == 'e' || *s == 'E') {
+        long long e;
+        const char *t = s + 1;
+        int eminus = (*t == '-');
+        if (*t == '-' || *t == '+') ++t;
+        if (*t < '0' || *t > '9') return -1;
+        for (e = 0; *t >= '0' && *t <= '9'; ++t) {
+            if (e < 100000) e = e * 10 + (*t - '0');
+        }
+        exponent += (int)(eminus ? -e : e);
+        s = t;
+    }
+    if (*s != '\0') return -1;
+
+    double v = (double)mantissa;
+    if (v != 0) {
+        int e = exponent < 0 ? -exponent : exponent;
+        double scale = 1;
+        while (e > 22) {
+            scale *= 1e22;
+            e -= 22;
+            if (scale > 1e308) break;
+        }
+        scale *= pow10[e > 22 ? 22 : e];
+        v = exponent < 0 ? v / scale : v * scale;
+        if (v > 1.7976931348623157e308) return -2;
+    }
+
+    *value = minus ? -v : v;
+    return 0;
+}
+
+/**
+ * @brief Parse a byte size.
+ * 
+ * The suffixes are K, M, G, T(1024 based, case insensitive), they can be
+ * followed by "B" or "iB", a bare "B" is bytes.
+ * 
+ * @param[in] s         Input string, like "512", "64K" or "2GiB".
+ * @param[out] value    Output value in bytes.
+ * 
+ * @return 0            Parse pass.
+ * @return -1           It is not a size.
+ * @return -2           It is out of the unsigned long long range.
+ */
+int miniopt_parse_size(const char *s, unsigned long long *value) {
+    unsigned long long v;
+    const char *next;
+    int status = miniopt_parse_uint(s, &v, &next);
+    if (status == -1) return -1;
+
+    int shift = 0;
+    switch (*next) {
+        case 'k': case 'K': shift = 10; break;
+        case 'm': case 'M': shift = 20; break;
+        case 'g': case 'G': shift = 30; break;
+        case 't': case 'T': shift = 40; break;
+        default: break;
+    }
+    if (shift) {
+        ++next;
+        if (next[0] == 'i' && next[1] == 'B') next += 2;
+        else if (next[0] == 'B') ++next;
+    } else if (next[0] == 'B') {
+        ++next;
+    }
+    if (*next != '\0') return -1;
+    if (status == -2 || v > (~0ull >> shift)) return -2;
+
+    *value = v << shift;
+    return 0;
+}
+
+/**
+ * @brief Parse a duration.
+ * 
+ * It is one or more integers with units: "ns", "us", "ms", "s", "m", "h",
+ * like "250ms" or "1h30m". A bare "0" is allowed.
+ * 
+ * @param[in] s         Input string.
+ * @param[out] value    Output value in nanoseconds.
+ * 
+ * @return 0            Parse pass.
+ * @return -1           It is not a duration.
+ * @return -2           It is out of the unsigned long long range.
+ */
+int miniopt_parse_duration(const char *s, unsigned long long *value) {
+    if (s[0] == '0' && s[1] == '\0') {
+        *value = 0;
+        return 0;
+    }
+
+    unsigned long long total = 0;
+    int overflow = 0;
+    do {
+        unsigned long long v;
+        const char *next;
+        // No sign or hex here, miniopt_parse_uint() takes "0x" itself.
+        if (*s < '0' || *s > '9') return -1;
+        if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) return -1;
+        int status = miniopt_parse_uint(s, &v, &next);
+        if (status == -1) return -1;
+        if (status == -2) overflow = 1;
+
+        unsigned long long unit;
+        if (next[0] == 'n' && next[1] == 's') {
+            unit = 1, next += 2;
+        } else if (next[0] == 'u' && next[1] == 's') {
+            unit = 1000ull, next += 2;
+        } else if (next[0] == 'm' && next[1] == 's') {
+            unit = 1000000ull, next += 2;
+        } else if (next[0] == 's') {
+            unit = 1000000000ull, next += 1;
+        } else if (next[0] == 'm') {
+            unit = 60000000000ull, next += 1;
+        } else if (next[0] == 'h') {
+            unit = 3600000000000ull, next += 1;
+        } else {
+            return -1;
+        }
+
+        if (v > ~0ull / unit || total > ~0ull - v * unit) overflow = 1;
+        total += v * unit;
+        s = next;
+    } while (*s != '\0');
+
+    if (overflow) return -2;
+    *value = total;
+    return 0;
+}
+
+/**
+ * @brief Report a parse status of current argument through the context.
+ * 
+ * @param[in] ctx       Option context.
+ * @param[in] status    Parse status, 0, -1(not valid) or -2(out of range).
+ * 
+ * @return MINIOPT_PASS         Status is 0.
+ * @return MINIOPT_ERROR        Else, the context is in error state.
+ */
+int miniopt_check_value(option_context *ctx, int status) {
+    if (status == 0) return MINIOPT_PASS;
+    miniopt_make_error(ctx,
+                       status == -2 ? MINIOPT_ERR_OUT_OF_RANGE
+                                    : MINIOPT_ERR_BAD_VALUE,
+                       ctx->argind, ctx->optind, ctx->optarg);
+    return MINIOPT_ERROR;
+}
+
+/**
+ * @brief Convert current argument to an integer in [min, max].
+ * 
+ * @param[in] ctx       Option context.
+ * @param[in] min       Min value.
+ * @param[in] max       Max value.
+ * @param[out] value    Output value, it is not changed if error.
+ * 
+ * @return MINIOPT_PASS         Convert pass.
+ * @return MINIOPT_ERROR        It is not valid or out of range.
  */
-int miniopt_optind_impl() {
-    return optctx.optind;
+int miniopt_ctx_int(option_context *ctx, long long min, long long max,
+                    long long *value) {
+    long long v = 0;
+    int status = -1;
+    if (ctx->optarg != nil) {
+        status = miniopt_parse_int(ctx->optarg, &v);
+        if (status == 0 && (v < min || v > max)) status = -2;
+    }
+    if (status == 0) *value = v;
+    return miniopt_check_value(ctx, status);
 }
 
 /**
- * @brief Get current option-argument or non-option-argument.
- *
- * It should be used after (miniopt.getopt() > 0);
- *
- * @return not nil     An argument.
- * @return nil         Current option has no argument.
+ * @brief Convert current argument to a float.
+ * 
+ * @param[in] ctx       Option context.
+ * @param[out] value    Output value, it is not changed if error.
+ * 
+ * @return MINIOPT_PASS         Convert pass.
+ * @return MINIOPT_ERROR        It is not valid or out of range.
  */
-const char *miniopt_optarg_impl() { 
-    return optctx.optarg; 
+int miniopt_ctx_float(option_context *ctx, double *value) {
+    int status = -1;
+    if (ctx->optarg != nil) {
+        status = miniopt_parse_float(ctx->optarg, value);
+    }
+    return miniopt_check_value(ctx, status);
 }
 
-void miniopt_print_desc(printf_fn printf_, const char* desc, int offset){
-    if(!desc) return;
-    
-    while(*desc){
-        if(*desc == '<' 
-           && *(desc+1) == 'b' 
-           && *(desc+2) == 'r' 
-           && *(desc+3) == '>'){
-            desc += 4;
-            printf_("\n");
-            for(int i = 0; i < offset; ++i){
-                printf_(" ");
+/**
+ * @brief Convert current argument to a byte size, see miniopt_parse_size().
+ * 
+ * @param[in] ctx       Option context.
+ * @param[out] value    Output value in bytes, it is not changed if error.
+ * 
+ * @return MINIOPT_PASS         Convert pass.
+ * @return MINIOPT_ERROR        It is not valid or out of range.
+ */
+int miniopt_ctx_size(option_context *ctx, unsigned long long *value) {
+    int status = -1;
+    if (ctx->optarg != nil) {
+        status = miniopt_parse_size(ctx->optarg, value);
+    }
+    return miniopt_check_value(ctx, status);
+}
+
+/**
+ * @brief Convert current argument to a duration, see
+ * miniopt_parse_duration().
+ * 
+ * @param[in] ctx       Option context.
+ * @param[out] value    Output value in nanoseconds, it is not changed if
+ *                      error.
+ * 
+ * @return MINIOPT_PASS         Convert pass.
+ * @return MINIOPT_ERROR        It is not valid or out of range.
+ */
+int miniopt_ctx_duration(option_context *ctx, unsigned long long *value) {
+    int status = -1;
+    if (ctx->optarg != nil) {
+        status = miniopt_parse_duration(ctx->optarg, value);
+    }
+    return miniopt_check_value(ctx, status);
+}
+
+/**
+ * @brief Help text writer, it buffers the text and flushes it to a sink.
+ */
+typedef struct option_writer_ {
+    char *buf;          ///< Buffer.
+    int size;           ///< Buffer size.
+    int pos;            ///< Buffered size.
+    int total;          ///< Total text size.
+    write_fn write;     ///< Sink, nil to write the buffer only.
+    void *user;         ///< Sink user data.
+    int status;         ///< 0 or -1 if the sink fails.
+} option_writer;
+
+/**
+ * @brief Flush the buffered text to the sink.
+ */
+void miniopt_write_flush(option_writer *w) {
+    if (w->write == nil || w->pos == 0) return;
+    if (w->status == 0 && w->write(w->user, w->buf, w->pos) != w->pos) {
+        w->status = -1;
+    }
+    w->pos = 0;
+}
+
+/**
+ * @brief Write n same chars, they are counted but dropped if the buffer is
+ * full and there is no sink.
+ */
+void miniopt_write_chars(option_writer *w, char c, int n) {
+    for (; n > 0; --n) {
+        if (w->pos == w->size) {
+            if (w->write == nil) {
+                ++w->total;
+                continue;
             }
+            miniopt_write_flush(w);
         }
-        else{
-            printf_("%c", *desc++);
-        }
+        w->buf[w->pos++] = c;
+        ++w->total;
     }
-    
-    printf_("\n");
 }
 
-void miniopt_print_one_opt(printf_fn printf_,
-                           option* opt, 
-                           int maxShortOptSize, 
-                           int maxLongOptSize, 
-                           int maxAhintSize, 
-                           int offset,
-                           int indention){
-    int rest = offset;
-    for(int i = 0; i < indention; ++i){
-        printf_(" ");
+/**
+ * @brief Write a string.
+ */
+void miniopt_write_str(option_writer *w, const char *s) {
+    while (*s) { miniopt_write_chars(w, *s++, 1); }
+}
+
+/**
+ * @brief Write an option description, "<br>" starts a new line at offset.
+ */
+void miniopt_render_desc(option_writer *w, const char *desc, int offset) {
+    if (!desc) return;
+
+    while (*desc) {
+        if (desc[0] == '<' && desc[1] == 'b' && desc[2] == 'r' &&
+            desc[3] == '>') {
+            desc += 4;
+            miniopt_write_chars(w, '\n', 1);
+            miniopt_write_chars(w, ' ', offset);
+        } else {
+            miniopt_write_chars(w, *desc++, 1);
+        }
     }
-    
-    if(opt->sname != nil){
-        printf_("-%c", opt->sname);
+
+    miniopt_write_chars(w, '\n', 1);
+}
+
+/**
+ * @brief Write one option line(s) of the help text.
+ */
+void miniopt_render_one_opt(option_writer *w, const option_layout *layout,
+                            const option *opt, int offset, int indention) {
+    int rest = offset - indention;
+    miniopt_write_chars(w, ' ', indention);
+
+    if (opt->sname != nil) {
+        miniopt_write_chars(w, '-', 1);
+        miniopt_write_chars(w, opt->sname, 1);
         rest -= 2;
+    } else if (layout->shortSize) {
+        miniopt_write_chars(w, ' ', layout->shortSize);
+        rest -= layout->shortSize;
     }
-    else if(maxShortOptSize)
-    {
-        for(int i = 0; i < maxShortOptSize; ++i){
-            printf_(" ");
-        }
-        rest -= maxShortOptSize;
-    }
-    
-    if(maxShortOptSize && maxLongOptSize){
-        printf_(" ");
+
+    if (layout->shortSize && layout->longSize) {
+        miniopt_write_chars(w, ' ', 1);
         rest -= 1;
     }
 
-    if(opt->lname != nil){
-        printf_("--%s", opt->lname);
+    if (opt->lname != nil) {
+        miniopt_write_str(w, "--");
+        miniopt_write_str(w, opt->lname);
         rest -= miniopt_strlen(opt->lname) + 2;
     }
-    
-    if(opt->ahint != nil){
-        printf_(" %s", opt->ahint);
+
+    if (opt->ahint != nil) {
+        miniopt_write_chars(w, ' ', 1);
+        miniopt_write_str(w, opt->ahint);
         rest -= miniopt_strlen(opt->ahint) + 1;
     }
-    
-    rest -= indention;
-    while(rest > 0){
-        printf_(" ");
-        --rest;
+
+    miniopt_write_chars(w, ' ', rest);
+    miniopt_render_desc(w, opt->desc, offset);
+}
+
+/**
+ * @brief Write the help text of the option array.
+ */
+void miniopt_render_opts(option_writer *w, const option_spec *spec,
+                         int indention) {
+    int offset = spec->layout.offset + indention;
+    for (int i = 0; i < spec->optsum; ++i) {
+        miniopt_render_one_opt(w, &spec->layout, &spec->opts[i], offset,
+                               indention);
     }
+}
 
-    miniopt_print_desc(printf_, opt->desc, offset);
+/**
+ * @brief Render the help text of the option array into a buffer.
+ * 
+ * @param[in] spec          Option spec.
+ * @param[in] indention     Indention at the line beginning.
+ * @param[out] buf          Output buffer, the text is terminated by '\0'.
+ * @param[in] bufsize       Output buffer size.
+ * 
+ * @return int >= 0         The text size(without '\0'), the text is cut if
+ *                          it is not less than bufsize.
+ */
+int miniopt_spec_render(const option_spec *spec, int indention, char *buf,
+                        int bufsize) {
+    option_writer w = {buf, bufsize > 0 ? bufsize - 1 : 0, 0, 0, nil, nil, 0};
+    if (spec->opts != nil) miniopt_render_opts(&w, spec, indention);
+    if (bufsize > 0) buf[w.pos] = '\0';
+    return w.total;
 }
 
+/**
+ * @brief Render the help text of the option array to a sink.
+ * 
+ * The text is buffered in HELP_BUF_SIZE chunks, so a help text not more
+ * than that costs one write.
+ * 
+ * @param[in] spec          Option spec.
+ * @param[in] indention     Indention at the line beginning.
+ * @param[in] write         Sink function.
+ * @param[in] user          Sink user data.
+ * 
+ * @return 0                Write pass.
+ * @return -1               The sink fails.
+ */
+int miniopt_spec_writeopts(const option_spec *spec, int indention,
+                           write_fn write, void *user) {
+    char buf[HELP_BUF_SIZE];
+    option_writer w = {buf, HELP_BUF_SIZE, 0, 0, write, user, 0};
+    if (spec->opts != nil) miniopt_render_opts(&w, spec, indention);
+    miniopt_write_flush(&w);
+    return w.status;
+}
 
-void miniopt_internal_print_opts(printf_fn printf_, 
-                                 option* opts, 
-                                 int optsum, 
-                                 int indention){
-    int maxShortOptSize = 0;
-    int maxLongOptSize = 0;
-    int maxAhintSize = 0;
-    int offset = 0;     // offset to opt.desc.
+/**
+ * @brief Printf sink data.
+ */
+typedef struct option_printer_ {
+    printf_fn printf_;  ///< User provide printf function.
+    char *buf;          ///< Writer buffer, it has a byte for '\0' more.
+} option_printer;
 
-    for(int i = 0; i < optsum; ++i){
-        int total = 0;
+/**
+ * @brief Sink writes to a printf function.
+ * 
+ * The chunk is terminated by '\0' in the writer buffer and printed by "%s",
+ * so the printf function needs no "%.*s".
+ * 
+ * @param[in] user      Pointer to the option_printer.
+ */
+int miniopt_printf_write(void *user, const char *buf, int size) {
+    option_printer *printer = (option_printer *)user;
+    (void)buf;
+    miniopt_assert(buf == printer->buf);
+    printer->buf[size] = '\0';
+    printer->printf_("%s", printer->buf);
+    return size;
+}
 
-        int shortOptSize = opts[i].sname ? 1 : 0;
-        if(maxShortOptSize < shortOptSize){
-            shortOptSize += 1;  // For the leading '-'
-            maxShortOptSize = shortOptSize;
-            total += shortOptSize;
-        }
+/**
+ * @brief Print the option array.
+ * 
+ * @param[in] spec          Option spec.
+ * @param[in] printf_       User provide printf function.
+ * @param[in] indention     Indention at the line beginning.
+ */
+void miniopt_spec_printopts(const option_spec *spec, printf_fn printf_,
+                            int indention) {
+    if (printf_ == nil || spec->opts == nil) return;
+    char buf[HELP_BUF_SIZE];
+    option_printer printer = {printf_, buf};
+    option_writer w = {buf, HELP_BUF_SIZE - 1, 0, 0, miniopt_printf_write,
+                       &printer, 0};
+    miniopt_render_opts(&w, spec, indention);
+    miniopt_write_flush(&w);
+}
 
-        int longOptSize = miniopt_strlen(opts[i].lname);
-        if(maxLongOptSize < longOptSize){
-            longOptSize += 2;  // For the leading '--'
-            maxLongOptSize = longOptSize;
-            total += longOptSize;
-        }
+static option_spec optspec;     // Global option spec.
+static option_context optctx;   // Global option context.
+static option_spec optsubspec;  // Global subcommand option spec.
+static lookup_fn optlookup;     // Global long name lookup function.
+static const option_rule *optrules; // Global option rules.
+static int optrulesum;              // Global option rule sum.
+static option_allocator optalloc;   // Global allocator.
+static char **optenvp;              // Global environment variables.
+static const char *optenvprefix;    // Global env name prefix.
+static const char *optconfig;       // Global config file path.
+static const option_command *optcommands; // Global subcommands.
+static int optcommandsum;                 // Global subcommand sum.
+static int optprevalidated;               // Skip the option array checks.
+static const option_tables *opttables;    // Global prebuilt tables.
 
-        int ahintSize = miniopt_strlen(opts[i].ahint);
-        if(maxAhintSize < ahintSize){
-            ahintSize += 1; // For the leading ' '
-            maxAhintSize = ahintSize;
-            total += ahintSize;
-        }
-        if(offset < total){
-            offset = total;
-        }
+/**
+ * @brief Initialize miniopt object by the miniopt.set*() settings.
+ *
+ * @param[in] argc      Argument array size.
+ * @param[in] argv      Argument array.
+ * @param[in] opts      Option array.
+ * @param[in] optsum    Option sum of the option array.
+ *
+ * @return 0            Init pass.
+ * @return other        Init error.
+ */
+int miniopt_init_settings(int argc, char **argv, option *opts, int optsum) {
+    miniopt_ctx_release(&optctx);
+    miniopt_spec_release(&optspec);
+    alloc_fn fn = optalloc.fn ? optalloc.fn : MINIOPT_DEFAULT_ALLOC;
+    void *user = optalloc.fn ? optalloc.user : nil;
+    int status = miniopt_spec_setup(&optspec, opts, optsum, optlookup, fn,
+                                    user, !optprevalidated && opttables == nil,
+                                    opttables);
+    if (status == 0 && optrules != nil) {
+        status = miniopt_spec_rules(&optspec, optrules, optrulesum);
     }
-    
-    offset += indention;
-    // Add space between short name and long name like "-k --key".
-    if(maxShortOptSize && maxLongOptSize) offset += 1;
-    // Add spaces before opt.desc
-    offset += 3;
-    
-    for(int i = 0; i < optsum; ++i){
-        miniopt_print_one_opt(printf_,
-                              &opts[i], 
-                              maxShortOptSize, 
-                              maxLongOptSize, 
-                              maxAhintSize, 
-                              offset,
-                              indention);
+    if (status == 0 && optcommands != nil) {
+        status = miniopt_spec_commands(&optspec, optcommands, optcommandsum);
+    }
+    miniopt_ctx_init(&optctx, &optspec, argc, argv);
+    miniopt_ctx_setsubspec(&optctx, &optsubspec);
+    if (optalloc.fn != nil) {
+        miniopt_ctx_setalloc(&optctx, optalloc.fn, optalloc.user);
+    }
+    if (status != 0) {
+        miniopt_make_error(&optctx, MINIOPT_ERR_SPEC, -1, optspec.optsum, nil);
+        return status;
+    }
+    if (optconfig != nil) {
+#ifdef USING_MINIOPT_MMAP
+        status = miniopt_ctx_setconfig(&optctx, optconfig);
+#else
+        miniopt_make_error(&optctx, MINIOPT_ERR_CONFIG_READ, -1,
+                           optspec.optsum, optconfig);
+        status = MINIOPT_ERROR;
+#endif
+        if (status != MINIOPT_PASS) return -1;
+    }
+    if (miniopt_ctx_setenv(&optctx, optenvp, optenvprefix) != MINIOPT_PASS) {
+        return -1;
     }
+    return 0;
+}
+
+/**
+ * @brief Initialize miniopt object.
+ *
+ * The settings are reset after init, so a setting of an init is not used
+ * by a later init with another option array(for example a stale lookup).
+ * The spec and context keep what they need.
+ *
+ * @param[in] argc      Argument array size.
+ * @param[in] argv      Argument array.
+ * @param[in] opts      Option array.
+ * @param[in] optsum    Option sum of the option array.
+ *
+ * @return 0            Init pass.
+ * @return other        Init error.
+ */
+int miniopt_init_impl(int argc, char **argv, option *opts, int optsum) {
+    int status = miniopt_init_settings(argc, argv, opts, optsum);
+    optlookup = nil;
+    optrules = nil;
+    optrulesum = 0;
+    optalloc.fn = nil;
+    optalloc.user = nil;
+    optenvp = nil;
+    optenvprefix = nil;
+    optconfig = nil;
+    optcommands = nil;
+    optcommandsum = 0;
+    optprevalidated = 0;
+    opttables = nil;
+    return status;
+}
+
+/**
+ * @brief Get next option.
+ *
+ * @return MINIOPT_PASS         Get next option pass.
+ * @return MINIOPT_FINISHED     Work finished ok(no more option to get).
+ * @return MINIOPT_ERROR        Work finished or stopped with error.
+ */
+int miniopt_getopt_impl() {
+    return miniopt_ctx_getopt(&optctx);
+}
+
+/**
+ * @brief Parse all the args into the result arrays in one pass.
+ * 
+ * @param[out] result           Result arrays.
+ * @param[out] size             Result size has been written.
+ * 
+ * @return MINIOPT_PASS         Result arrays are full, there may be more.
+ * @return MINIOPT_FINISHED     Work finished ok(no more option to get).
+ * @return MINIOPT_ERROR        Work finished or stopped with error.
+ */
+int miniopt_parseall_impl(option_result *result, int *size) {
+    return miniopt_ctx_parseall(&optctx, result, size);
+}
+
+/**
+ * @brief Get current option index to the option array.
+ *
+ * @return [0, optsum-1]    An option index to the option array.
+ * @return optsum           It means miniopt.optarg() is non option argument.
+ */
+int miniopt_optind_impl() {
+    return miniopt_ctx_optind(&optctx);
+}
+
+/**
+ * @brief Get current option-argument or non-option-argument.
+ *
+ * @return not nil     An argument.
+ * @return nil         Current option has no argument.
+ */
+const char *miniopt_optarg_impl() { 
+    return miniopt_ctx_optarg(&optctx); 
+}
+
+/**
+ * @brief Get current argument as a string view.
+ *
+ * @return option_view      The argument, its data is nil if current option has
+ *                          no argument.
+ */
+option_view miniopt_optarg_view_impl() {
+    return miniopt_ctx_optarg_view(&optctx);
+}
+
+/**
+ * @brief Get current option name as a string view.
+ *
+ * @return option_view      The name, its data is nil if it is not an option.
+ */
+option_view miniopt_optname_view_impl() {
+    return miniopt_ctx_optname_view(&optctx);
 }
 
 /**
  * @brief Print the option array.
  * 
+ * @param[in] printf_       User provide printf function.
  * @param[in] indention     Indention at the line beginning.
  */
 void miniopt_printopts_impl(printf_fn printf_, int indention){
-    if(printf_ == nil || optctx.opts == nil) return;
-    miniopt_internal_print_opts(printf_,
-                                optctx.opts, 
-                                optctx.optsum, 
-                                indention);
+    miniopt_spec_printopts(&optspec, printf_, indention);
 }
 
 /**
@@ -773,7 +4095,135 @@ void miniopt_printopts_impl(printf_fn printf_, int indention){
  * @return nil         No error.
  */
 const char *miniopt_what_impl() { 
-    return optctx.error; 
+    return miniopt_ctx_what(&optctx); 
+}
+
+/**
+ * @brief Get current error.
+ *
+ * @return option_error     Current error, its code is MINIOPT_ERR_NONE if no
+ *                          error.
+ */
+const option_error *miniopt_error_impl() {
+    return miniopt_ctx_error(&optctx);
+}
+
+/**
+ * @brief Convert current argument to an integer in [min, max].
+ */
+int miniopt_optint_impl(long long min, long long max, long long *value) {
+    return miniopt_ctx_int(&optctx, min, max, value);
+}
+
+/**
+ * @brief Convert current argument to a float.
+ */
+int miniopt_optfloat_impl(double *value) {
+    return miniopt_ctx_float(&optctx, value);
+}
+
+/**
+ * @brief Convert current argument to a byte size.
+ */
+int miniopt_optsize_impl(unsigned long long *value) {
+    return miniopt_ctx_size(&optctx, value);
+}
+
+/**
+ * @brief Convert current argument to a duration in nanoseconds.
+ */
+int miniopt_optduration_impl(unsigned long long *value) {
+    return miniopt_ctx_duration(&optctx, value);
+}
+
+/**
+ * @brief Set long name lookup function.
+ * 
+ * @param[in] lookup    User provide lookup function, nil to use default.
+ */
+void miniopt_setlookup_impl(lookup_fn lookup) {
+    optlookup = lookup;
+}
+
+/**
+ * @brief Set option rules.
+ * 
+ * @param[in] rules     Rule array, nil for no rule.
+ * @param[in] rulesum   Rule sum of the rule array.
+ */
+void miniopt_setrules_impl(const option_rule *rules, int rulesum) {
+    optrules = rules;
+    optrulesum = rulesum;
+}
+
+/**
+ * @brief Set the allocator.
+ * 
+ * @param[in] fn        Allocator function, nil for no allocator.
+ * @param[in] user      User data of the allocator function.
+ */
+void miniopt_setalloc_impl(alloc_fn fn, void *user) {
+    optalloc.fn = fn;
+    optalloc.user = user;
+}
+
+/**
+ * @brief Set the environment variables.
+ * 
+ * @param[in] envp      Environment variables, nil for no env.
+ * @param[in] prefix    Name prefix of the env names.
+ */
+void miniopt_setenv_impl(char **envp, const char *prefix) {
+    optenvp = envp;
+    optenvprefix = prefix;
+}
+
+/**
+ * @brief Set the config file, it needs USING_MINIOPT_MMAP.
+ * 
+ * @param[in] path      Config file path, nil for no config file.
+ */
+void miniopt_setconfig_impl(const char *path) {
+    optconfig = path;
+}
+
+/**
+ * @brief Set the subcommands.
+ * 
+ * @param[in] cmds      Subcommand array, nil for no subcommand.
+ * @param[in] cmdsum    Subcommand sum of the subcommand array.
+ */
+void miniopt_setcommands_impl(const option_command *cmds, int cmdsum) {
+    optcommands = cmds;
+    optcommandsum = cmdsum;
+}
+
+/**
+ * @brief Get current subcommand index.
+ * 
+ * @return [0, cmdsum-1]    Subcommand index to the subcommand array.
+ * @return -1               No subcommand is got.
+ */
+int miniopt_command_impl() {
+    return miniopt_ctx_command(&optctx);
+}
+
+/**
+ * @brief Set whether the option array is prevalidated.
+ * 
+ * @param[in] prevalidated  Not 0 to skip the option array checks in init.
+ */
+void miniopt_setprevalidated_impl(int prevalidated) {
+    optprevalidated = prevalidated;
+}
+
+/**
+ * @brief Set the prebuilt tables of the option array.
+ *
+ * @param[in] tables    Prebuilt tables, they should live until exit.
+ */
+void miniopt_settables_impl(const option_tables *tables) {
+    opttables = tables;
 }
 
 /**
@@ -785,5 +4235,22 @@ Miniopt miniopt = {
     miniopt_optind_impl,
     miniopt_optarg_impl,
     miniopt_printopts_impl,
-    miniopt_what_impl
+    miniopt_what_impl,
+    miniopt_setlookup_impl,
+    miniopt_parseall_impl,
+    miniopt_optarg_view_impl,
+    miniopt_optname_view_impl,
+    miniopt_error_impl,
+    miniopt_optint_impl,
+    miniopt_optfloat_impl,
+    miniopt_optsize_impl,
+    miniopt_optduration_impl,
+    miniopt_setrules_impl,
+    miniopt_setalloc_impl,
+    miniopt_setenv_impl,
+    miniopt_setconfig_impl,
+    miniopt_setcommands_impl,
+    miniopt_command_impl,
+    miniopt_setprevalidated_impl,
+    miniopt_settables_impl
 };
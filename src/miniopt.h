@@ -31,6 +31,234 @@ extern "C" {
 #define OPTION_NAME_MAX_SIZE 32
 #define ERROR_STR_MAX_SIZE 128
 
+//
+// Slot size of the inline long name hash index, it should be power of 2.
+// The index has the power of 2 slots of at least twice the long names, it is
+// in the inline slots if it fits, or else it is got from the spec allocator,
+// see miniopt_spec_init().
+//
+#ifndef LONG_INDEX_INLINE_SIZE
+#define LONG_INDEX_INLINE_SIZE 1024
+#endif
+
+//
+// If you need vectorized long name matching, define USING_MINIOPT_SIMD before
+// include this file(and when build miniopt.c). The long names of the hash
+// index are copied into a zero padded, 32 bytes aligned name table, then a
+// "--key" token is matched by SSE2/AVX2 compare(scalar 64 bits compare if
+// they are not available). The table costs 32 bytes per hash slot.
+//
+//
+// The library has no default allocator, set one(e.g. an arena) for the
+// dynamic features, see alloc_fn. If you want malloc and free as the default
+// allocator, define USING_MINIOPT_HEAP before include this file(and when
+// build miniopt.c).
+//
+//
+// If you need "@file" response files, define USING_MINIOPT_MMAP before include
+// this file(and when build miniopt.c), it needs POSIX mmap. A "@file" token is
+// replaced by the tokens in the file, the file is memory-mapped(private) and
+// tokenized in place, so the tokens are not copied. Tokens are separated by
+// spaces, '"' or '\'' quotes a part of token and '\\' escapes next char. A
+// "@file" token in a response file is not expanded. A "key = value" config
+// file is mapped the same way, see miniopt_ctx_setconfig().
+//
+//
+// If you need GNU style long name abbreviation("--app" for "--append" if no
+// other long name begins with "app"), define USING_MINIOPT_ABBREV before
+// include this file(and when build miniopt.c). A trie of the long names is
+// built by init, an abbreviation is resolved in one walk of the token, and
+// an ambiguous one is an error. A whole long name wins, so "--color" is not
+// ambiguous with "--colors". The trie has at most ABBREV_NODE_MAX_SIZE
+// nodes(about the total size of the long names).
+//
+//
+// Buffer sizes of the NUL-delimited token stream, see option_stream.
+//
+#ifndef STREAM_BUF_SIZE
+#define STREAM_BUF_SIZE 4096
+#endif
+#ifndef STREAM_TOKEN_MAX_SIZE
+#define STREAM_TOKEN_MAX_SIZE 4096
+#endif
+
+// Slot size of the environment variable name hash index, it should be power
+// of 2, at most half of it options can have an env name, see option.env.
+#ifndef ENV_INDEX_MAX_SIZE
+#define ENV_INDEX_MAX_SIZE 256
+#endif
+
+// Slot size of the subcommand name hash index, it should be power of 2, at
+// most half of it subcommands can be used, see option_command.
+#ifndef COMMAND_INDEX_MAX_SIZE
+#define COMMAND_INDEX_MAX_SIZE 128
+#endif
+
+// Max options can be used by option rules(a multiple of 64), the options of
+// the rules are mapped to the bits of bitsets of this size, the option array
+// can be bigger, see option_rule.
+#ifndef RULE_OPTION_MAX_SIZE
+#define RULE_OPTION_MAX_SIZE 64
+#endif
+#define RULE_WORD_SIZE (RULE_OPTION_MAX_SIZE / 64)
+#define RULE_INDEX_SIZE (RULE_OPTION_MAX_SIZE * 2)
+
+// Max long names suggested for an unknown option, see miniopt_ctx_suggest().
+#ifndef SUGGEST_MAX_SIZE
+#define SUGGEST_MAX_SIZE 3
+#endif
+
+// Stack buffer size of printopts, a help text fits in it is one write.
+#ifndef HELP_BUF_SIZE
+#define HELP_BUF_SIZE 4096
+#endif
+
+#ifdef USING_MINIOPT_MMAP
+#include <stddef.h>
+#ifndef RESPONSE_FILE_MAX_SIZE
+#define RESPONSE_FILE_MAX_SIZE 16   // Max response file sum of each context.
+#endif
+#endif
+
+#ifdef USING_MINIOPT_ABBREV
+#ifndef ABBREV_NODE_MAX_SIZE
+#define ABBREV_NODE_MAX_SIZE 4096
+#endif
+
+/**
+ * @brief Long name trie node, node 0 is the root.
+ */
+typedef struct option_trie_node_ {
+    int child;              ///< First child node, 0 if none.
+    int next;               ///< Next sibling node, 0 if none.
+    int optind;             ///< The only option below, -2 if more than one.
+    int end;                ///< Option whose long name ends here, or -1.
+    char c;                 ///< Name char.
+} option_trie_node;
+#endif
+
+#ifdef USING_MINIOPT_SIMD
+#if OPTION_NAME_MAX_SIZE != 32
+#error "USING_MINIOPT_SIMD requires OPTION_NAME_MAX_SIZE is 32."
+#endif
+#if defined(_MSC_VER)
+#define MINIOPT_ALIGN(n) __declspec(align(n))
+#else
+#define MINIOPT_ALIGN(n) __attribute__((aligned(n)))
+#endif
+
+/**
+ * @brief Zero padded long name.
+ */
+typedef union option_name_ {
+    char str[OPTION_NAME_MAX_SIZE];                         ///< Name chars.
+    unsigned long long u64[OPTION_NAME_MAX_SIZE / 8];       ///< Name words.
+} option_name;
+#endif
+
+/**
+ * @brief Bound option kinds, see option.kind.
+ */
+typedef enum option_kind_ {
+    MINIOPT_KIND_NONE = 0,      ///< Not bound, it is returned by getopt.
+    MINIOPT_KIND_FLAG,          ///< int *dest = 1.
+    MINIOPT_KIND_COUNTER,       ///< ++(int *dest), "-vvv" adds 3.
+    MINIOPT_KIND_STRING,        ///< const char **dest = optarg.
+    MINIOPT_KIND_INT,           ///< long long *dest = optarg as integer.
+    MINIOPT_KIND_CALLBACK,      ///< option_callback *dest is called.
+    MINIOPT_KIND_LIST           ///< option_list *dest gathers all optargs.
+} option_kind;
+
+/**
+ * @brief Bound list option values, see MINIOPT_KIND_LIST.
+ * 
+ * The values are in argv order, they are valid after getopt returns
+ * MINIOPT_FINISHED and until the allocator memory is freed(for example an
+ * arena is reset).
+ */
+typedef struct option_list_ {
+    const char **items;     ///< Value array, nil if size is 0.
+    int size;               ///< Value sum.
+} option_list;
+
+/**
+ * @brief Allocator function declaration.
+ * 
+ * Every dynamic memory of the library is got from it, the library calls
+ * malloc only in miniopt_heap_alloc_fn, which is built and is the default
+ * allocator with USING_MINIOPT_HEAP. The memory should be aligned to
+ * pointer size.
+ * 
+ * @param[in] user      User data.
+ * @param[in] ptr       nil to allocate, or the memory to free.
+ * @param[in] size      Bytes to allocate, it is 0 to free ptr.
+ * 
+ * @return not nil      Allocated memory.
+ * @return nil          Cannot allocate, or ptr is freed.
+ */
+typedef void *(*alloc_fn)(void *user, void *ptr, int size);
+
+/**
+ * @brief Allocator hook, see alloc_fn.
+ */
+typedef struct option_allocator_ {
+    alloc_fn fn;            ///< Allocator function, nil for no allocator.
+    void *user;             ///< User data.
+} option_allocator;
+
+/**
+ * @brief Caller supplied bump arena, free is a no-op and reset frees all.
+ */
+typedef struct option_arena_ {
+    char *data;             ///< Arena buffer.
+    int size;               ///< Arena buffer size.
+    int used;               ///< Bytes have been allocated.
+} option_arena;
+
+/**
+ * @brief Caller supplied fixed-block pool, the free blocks are linked.
+ */
+typedef struct option_pool_ {
+    char *data;             ///< Pool buffer.
+    int blockSize;          ///< Block size, aligned to pointer size.
+    int blockSum;           ///< Block sum of the buffer.
+    int used;               ///< Blocks have been carved from the buffer.
+    void *freeList;         ///< Freed blocks.
+} option_pool;
+
+/**
+ * @brief List option value node, it is allocated by the allocator.
+ */
+typedef struct option_list_node_ {
+    const char *value;                  ///< Option argument.
+    int optind;                         ///< Option index.
+    struct option_list_node_ *prev;     ///< Previous node, nil if first.
+} option_list_node;
+
+struct option_context_;
+
+/**
+ * @brief Bound option callback function declaration.
+ * 
+ * The current option and argument can be got from the context, for example
+ * by miniopt_ctx_optarg() or miniopt_ctx_int().
+ * 
+ * @param[in] user      User data.
+ * @param[in] ctx       Option context.
+ * 
+ * @return MINIOPT_PASS     Pass.
+ * @return MINIOPT_ERROR    Error, parsing stops.
+ */
+typedef int (*callback_fn)(void *user, struct option_context_ *ctx);
+
+/**
+ * @brief Bound option callback.
+ */
+typedef struct option_callback_ {
+    callback_fn fn;     ///< Callback function.
+    void *user;         ///< User data.
+} option_callback;
+
 /**
  * @brief Option.
  * 
@@ -45,23 +273,94 @@ extern "C" {
  *   - it cannot begin with '-' or '='.
  *   - it cannot use character '='.
  *   - its string length cannot more than OPTION_NAME_MAX_SIZE.
+ * - A short or long name cannot be used by more than one option.
  * 
  * - If option.ahint is nil, it means the option has no argument.
  * - If option.ahint is not nil, it means the option has an argument.
  * - No option argument is always provided to user if it exists.
  * 
  * - If you need line break in the option.desc, use "<br>" to insert new line.
+ * 
+ * - option.kind and option.dest can be omitted(they are zero), then the
+ *   option is returned by getopt. If option.kind is not MINIOPT_KIND_NONE,
+ *   the parser stores the option into option.dest and does not return it:
+ *   - FLAG and COUNTER options cannot have an argument.
+ *   - STRING, INT and LIST options should have an argument.
+ * 
+ * - option.env can be omitted, or it is an environment variable name(it
+ *   cannot use character '='), see miniopt_ctx_setenv().
  */
 typedef struct option_ {
     const char sname;     ///< Short name;
     const char *lname;    ///< Long name;
     const char *ahint;    ///< Argument hint;
     const char *desc;     ///< Description;
+    int kind;             ///< Bound kind, see option_kind;
+    void *dest;           ///< Bound destination;
+    const char *env;      ///< Environment variable name(without prefix);
 } option;
 
+/**
+ * @brief Long name lookup function declaration.
+ * 
+ * @param[in] beg   Long name begin.
+ * @param[in] end   Long name end.
+ * 
+ * @return [0, optsum-1]    An option index to the option array.
+ * @return -1               It is not a long name.
+ */
+typedef int (*lookup_fn)(const char *beg, const char *end);
+
+/**
+ * @brief Subcommand("git commit"), it has its own option array.
+ * 
+ * The option array of a subcommand is checked and indexed only when the
+ * subcommand is invoked, so many subcommands do not slow down init. The env
+ * and the "[name]" section of the config file fill its options, see
+ * miniopt_ctx_setenv() and miniopt_ctx_setconfig().
+ */
+typedef struct option_command_ {
+    const char *name;     ///< Subcommand name, it cannot begin with '-'.
+    option *opts;         ///< Option array of the subcommand.
+    int optsum;           ///< Option sum of the option array.
+    lookup_fn lookup;     ///< Long name lookup of the array, it can be nil.
+} option_command;
+
+/**
+ * @brief Help text column layout, it is got in the short name index pass.
+ */
+typedef struct option_layout_ {
+    int shortSize;      ///< Short name width.
+    int longSize;       ///< Long name width.
+    int ahintSize;      ///< Arg hint width.
+    int offset;         ///< Description column.
+} option_layout;
+
+/**
+ * @brief Prebuilt name indexes of an option array, see
+ * miniopt_spec_init_tables().
+ *
+ * The code generator emits them as static data with its option array(and
+ * a long name lookup function), so a prevalidated init only points the spec
+ * at them, no name is hashed or checked. They are got from a spec built at
+ * run time by miniopt_spec_tables().
+ */
+typedef struct option_tables_ {
+    const int *shortIndex;              ///< 256 short name slots, or -1.
+    const unsigned char *shortHasArg;   ///< Bitset of short names have arg.
+    const int *envIndex;                ///< Env name hash slots, or nil.
+    unsigned int envMask;               ///< Env name hash slot size - 1.
+    int listed;                         ///< Whether there is a list option.
+    /// Help text column layout, a zero one is computed by init.
+    option_layout layout;
+} option_tables;
+
 /**
  * @brief Initialize miniopt object.
  *
+ * The miniopt.set*() settings are used by this init only, then they are
+ * reset, so set them again before the next init.
+ *
  * @param[in] argc      Argument array size.
  * @param[in] argv      Argument array.
  * @param[in] opts      Option array.
@@ -72,6 +371,7 @@ typedef struct option_ {
  */
 typedef int (*miniopt_init)(int argc, char **argv, option *opts, int optsum);
 
+#define MINIOPT_COMMAND 2
 #define MINIOPT_PASS 1
 #define MINIOPT_FINISHED 0
 #define MINIOPT_ERROR -1
@@ -80,6 +380,9 @@ typedef int (*miniopt_init)(int argc, char **argv, option *opts, int optsum);
  * 
  * It should be used after miniopt.init();
  *
+ * @return MINIOPT_COMMAND      A subcommand is got(optarg is its name), the
+ *                              next options are of the subcommand option
+ *                              array, see miniopt.setcommands().
  * @return MINIOPT_PASS         Get next option pass.
  * @return MINIOPT_FINISHED     Work finished ok(no more option to get).
  * @return MINIOPT_ERROR        Work finished or stopped with error.
@@ -108,6 +411,36 @@ typedef int (*miniopt_optind)();
  */
 typedef const char *(*miniopt_optarg)();
 
+/**
+ * @brief String view, it is a string begin and its size.
+ */
+typedef struct option_view_ {
+    const char *data;       ///< String begin.
+    int size;               ///< String size.
+} option_view;
+
+/**
+ * @brief Get current option-argument or non-option-argument as a string view.
+ *
+ * It should be used after (miniopt.getopt() > 0), the size is computed at
+ * most once.
+ *
+ * @return option_view      The argument, its data is NULL if current option
+ *                          has no argument.
+ */
+typedef option_view (*miniopt_optargview)();
+
+/**
+ * @brief Get current option name as a string view.
+ *
+ * It should be used after (miniopt.getopt() > 0), the name is not terminated
+ * by '\0', it points into the token("--key=value" gives "key").
+ *
+ * @return option_view      The name, its data is NULL if miniopt.optarg() is
+ *                          non option argument.
+ */
+typedef option_view (*miniopt_optnameview)();
+
 /**
  * @brief printf function declaration.
  */
@@ -121,6 +454,16 @@ typedef int (*printf_fn)(char const* const _Format, ...);
  */
 typedef void (*miniopt_printopts)(printf_fn printf_, int indention);
 
+/**
+ * @brief Set long name lookup function.
+ * 
+ * It should be used before miniopt.init(), then init will not build the long
+ * name index. The code generator generates a perfect hash one for this.
+ * 
+ * @param[in] lookup    User provide lookup function, nil to use default.
+ */
+typedef void (*miniopt_setlookup)(lookup_fn lookup);
+
 /**
  * @brief Get current error str.
  *
@@ -129,6 +472,224 @@ typedef void (*miniopt_printopts)(printf_fn printf_, int indention);
  */
 typedef const char *(*miniopt_what)();
 
+#define MINIOPT_RULE_REQUIRED 1     // Option should be given.
+#define MINIOPT_RULE_REQUIRES 2     // Option requires the other option.
+#define MINIOPT_RULE_EXCLUSIVE 3    // Option cannot be used with the other.
+/**
+ * @brief Option rule, it is checked while parsing.
+ * 
+ * At most RULE_OPTION_MAX_SIZE options can be used by the rules of an option
+ * array. An exclusive rule is checked when an option is got, the other rules
+ * are checked when parsing finishes.
+ */
+typedef struct option_rule_ {
+    int kind;       ///< MINIOPT_RULE_REQUIRED, REQUIRES or EXCLUSIVE.
+    int optind;     ///< Option index.
+    int other;      ///< The other option index, it is not used by REQUIRED.
+} option_rule;
+
+/**
+ * @brief Set option rules.
+ * 
+ * It should be used before miniopt.init(), the rules should be valid until
+ * parsing finishes.
+ * 
+ * @param[in] rules     Rule array, nil for no rule.
+ * @param[in] rulesum   Rule sum of the rule array.
+ */
+typedef void (*miniopt_setrules)(const option_rule *rules, int rulesum);
+
+/**
+ * @brief Set the allocator.
+ * 
+ * It should be used before miniopt.init(), see alloc_fn.
+ * 
+ * @param[in] fn        Allocator function, nil for no allocator.
+ * @param[in] user      User data of the allocator function.
+ */
+typedef void (*miniopt_setalloc)(alloc_fn fn, void *user);
+
+/**
+ * @brief Set the environment variables, see miniopt_ctx_setenv().
+ * 
+ * It should be used before miniopt.init(), and after miniopt.setalloc().
+ * 
+ * @param[in] envp      Environment variables("KEY=value"), nil for no env.
+ * @param[in] prefix    Name prefix of the env names, for example "MYAPP_".
+ */
+typedef void (*miniopt_setenv)(char **envp, const char *prefix);
+
+/**
+ * @brief Set the config file, see miniopt_ctx_setconfig().
+ * 
+ * It should be used before miniopt.init(), and after miniopt.setalloc().
+ * 
+ * @param[in] path      Config file path, nil for no config file.
+ */
+typedef void (*miniopt_setconfig)(const char *path);
+
+/**
+ * @brief Set the subcommands, see miniopt_spec_commands().
+ * 
+ * It should be used before miniopt.init(), and after miniopt.setalloc().
+ * 
+ * @param[in] cmds      Subcommand array, nil for no subcommand.
+ * @param[in] cmdsum    Subcommand sum of the subcommand array.
+ */
+typedef void (*miniopt_setcommands)(const option_command *cmds, int cmdsum);
+
+/**
+ * @brief Get current subcommand index.
+ * 
+ * @return [0, cmdsum-1]    Subcommand index to the subcommand array.
+ * @return -1               No subcommand is got.
+ */
+typedef int (*miniopt_command)();
+
+/**
+ * @brief Set whether the option array is prevalidated, see
+ * miniopt_spec_init_prevalidated().
+ * 
+ * It should be used before miniopt.init().
+ * 
+ * @param[in] prevalidated  Not 0 to skip the option array checks in init.
+ */
+typedef void (*miniopt_setprevalidated)(int prevalidated);
+
+/**
+ * @brief Set the prebuilt tables of the option array, see
+ * miniopt_spec_init_tables().
+ * 
+ * It should be used before miniopt.init(), the option array is taken as
+ * prevalidated too.
+ * 
+ * @param[in] tables    Prebuilt tables, they should live until exit.
+ */
+typedef void (*miniopt_settables)(const option_tables *tables);
+
+/**
+ * @brief Error codes.
+ */
+typedef enum option_errc_ {
+    MINIOPT_ERR_NONE = 0,           ///< No error.
+    MINIOPT_ERR_SPEC,               ///< Option array is invalid.
+    MINIOPT_ERR_UNKNOWN_OPTION,     ///< Token begins with '-' is not option.
+    MINIOPT_ERR_MISSING_ARGUMENT,   ///< Option argument is missing.
+    MINIOPT_ERR_SHORT_GROUP,        ///< Short option group like "-abc" error.
+    MINIOPT_ERR_READ,               ///< Cannot read next token.
+    MINIOPT_ERR_RSP_TOO_MANY,       ///< Response files are too many.
+    MINIOPT_ERR_RSP_READ,           ///< Response file cannot be read.
+    MINIOPT_ERR_AMBIGUOUS_OPTION,   ///< Long name abbreviation is ambiguous.
+    MINIOPT_ERR_BAD_VALUE,          ///< Argument cannot be converted.
+    MINIOPT_ERR_OUT_OF_RANGE,       ///< Converted argument is out of range.
+    MINIOPT_ERR_REQUIRED,           ///< Required option is not given.
+    MINIOPT_ERR_REQUIRES,           ///< Option requires other option.
+    MINIOPT_ERR_EXCLUSIVE,          ///< Option cannot be used with other one.
+    MINIOPT_ERR_NO_MEMORY,          ///< Allocator cannot allocate.
+    MINIOPT_ERR_CONFIG_READ,        ///< Config file cannot be read.
+    MINIOPT_ERR_CONFIG_SYNTAX,      ///< Config line is not "key = value".
+    MINIOPT_ERR_SUM                 ///< Error code sum.
+} option_errc;
+
+/**
+ * @brief Structured error, no message is formatted until what() is called.
+ */
+typedef struct option_error_ {
+    option_errc code;       ///< Error code.
+    int argind;             ///< Argv index of the token, -1 if no token.
+    int optind;             ///< Option index, optsum if not an option.
+    int other;              ///< The other option index of a rule, or -1.
+    const char *file;       ///< Config file of the error, or nil.
+    int line;               ///< Config file line of the error, or 0.
+    const char *token;      ///< The token, nil if no token.
+} option_error;
+
+/**
+ * @brief Get current error.
+ *
+ * The code is MINIOPT_ERR_NONE if there is no error.
+ *
+ * @return option_error     Current error.
+ */
+typedef const option_error *(*miniopt_error)();
+
+/**
+ * @brief Convert current argument to an integer in [min, max].
+ *
+ * It accepts decimal or "0x" hex with an optional sign, and it is libc and
+ * locale free. An error stops parsing like other errors, see what().
+ *
+ * @param[in] min       Min value.
+ * @param[in] max       Max value.
+ * @param[out] value    Output value, it is not changed if error.
+ *
+ * @return MINIOPT_PASS         Convert pass.
+ * @return MINIOPT_ERROR        It is not valid or out of range.
+ */
+typedef int (*miniopt_optint)(long long min, long long max, long long *value);
+
+/**
+ * @brief Convert current argument to a float, like "-1.5" or "2.5e-3".
+ *
+ * @param[out] value    Output value, it is not changed if error.
+ *
+ * @return MINIOPT_PASS         Convert pass.
+ * @return MINIOPT_ERROR        It is not valid or out of range.
+ */
+typedef int (*miniopt_optfloat)(double *value);
+
+/**
+ * @brief Convert current argument to a byte size, like "512", "64K" or
+ * "2GiB"(K, M, G, T are 1024 based).
+ *
+ * @param[out] value    Output value in bytes, it is not changed if error.
+ *
+ * @return MINIOPT_PASS         Convert pass.
+ * @return MINIOPT_ERROR        It is not valid or out of range.
+ */
+typedef int (*miniopt_optsize)(unsigned long long *value);
+
+/**
+ * @brief Convert current argument to a duration, like "250ms" or "1h30m"
+ * (units are ns, us, ms, s, m, h).
+ *
+ * @param[out] value    Output value in nanoseconds, it is not changed if
+ *                      error.
+ *
+ * @return MINIOPT_PASS         Convert pass.
+ * @return MINIOPT_ERROR        It is not valid or out of range.
+ */
+typedef int (*miniopt_optduration)(unsigned long long *value);
+
+/**
+ * @brief Option results in structure-of-arrays form.
+ * 
+ * The result i is (optind[i], argind[i], optarg[i]), they are the same as
+ * miniopt.optind(), the argv index of the option(not its argument) and
+ * miniopt.optarg() after each miniopt.getopt().
+ */
+typedef struct option_result_ {
+    int *optind;            ///< Option index array.
+    int *argind;            ///< Argv index array.
+    const char **optarg;    ///< Option-arg or non-option-arg array.
+    int capacity;           ///< Size of each array.
+} option_result;
+
+/**
+ * @brief Parse all the args into the result arrays in one pass.
+ * 
+ * It should be used after miniopt.init(), and it can be used again to
+ * continue if the result arrays are full.
+ * 
+ * @param[out] result           Result arrays.
+ * @param[out] size             Result size has been written.
+ * 
+ * @return MINIOPT_PASS         Result arrays are full, there may be more.
+ * @return MINIOPT_FINISHED     Work finished ok(no more option to get).
+ * @return MINIOPT_ERROR        Work finished or stopped with error.
+ */
+typedef int (*miniopt_parseall)(option_result *result, int *size);
+
 /**
  * @brief Miniopt class.
  */
@@ -140,13 +701,825 @@ typedef struct Miniopt_ {
     miniopt_optarg      optarg;     ///< Get current opt-arg or non-opt-arg.
     miniopt_printopts   printopts;  ///< Print options.
     miniopt_what        what;       ///< Print any error.
+    miniopt_setlookup   setlookup;  ///< Set long name lookup function.
+    miniopt_parseall    parseall;   ///< Parse all the args in one pass.
+    miniopt_optargview  optargview; ///< Get current argument view.
+    miniopt_optnameview optnameview;///< Get current option name view.
+    miniopt_error       error;      ///< Get current error without message.
+    miniopt_optint      optint;     ///< Convert current argument to int.
+    miniopt_optfloat    optfloat;   ///< Convert current argument to float.
+    miniopt_optsize     optsize;    ///< Convert current argument to size.
+    miniopt_optduration optduration;///< Convert current argument to duration.
+    miniopt_setrules    setrules;   ///< Set option rules.
+    miniopt_setalloc    setalloc;   ///< Set the allocator.
+    miniopt_setenv      setenv;     ///< Set the environment variables.
+    miniopt_setconfig   setconfig;  ///< Set the config file.
+    miniopt_setcommands setcommands;///< Set the subcommands.
+    miniopt_command     command;    ///< Get current subcommand index.
+    miniopt_setprevalidated setprevalidated; ///< Skip option array checks.
+    miniopt_settables   settables;  ///< Set prebuilt name indexes.
 } Miniopt;
 
 /**
  * @brief Miniopt singleton object declaration.
+ * 
+ * It is a thin wrapper of a global option_spec and option_context, so it
+ * is not thread safe. Use the reentrant APIs below for that.
  */
 extern Miniopt miniopt;
 
+/**
+ * @brief Token source function declaration.
+ * 
+ * The token should be terminated by '\0', and it should be valid until the
+ * source is called two more times(the parser keeps current token and peeks
+ * next one).
+ * 
+ * @param[in] user      User data.
+ * @param[out] token    Output token.
+ * 
+ * @return 1            Get a token.
+ * @return 0            No more token.
+ * @return -1           Error.
+ */
+typedef int (*source_fn)(void *user, option_view *token);
+
+/**
+ * @brief Read function declaration, like POSIX read().
+ * 
+ * @param[in] user      User data.
+ * @param[out] buf      Output buffer.
+ * @param[in] size      Output buffer size.
+ * 
+ * @return > 0          Bytes have been read.
+ * @return 0            End of the input.
+ * @return -1           Error.
+ */
+typedef int (*read_fn)(void *user, char *buf, int size);
+
+/**
+ * @brief NUL-delimited token stream(like "xargs -0"), it is a token source.
+ * 
+ * It reads any long input in constant memory, see miniopt_stream_source().
+ */
+typedef struct option_stream_ {
+    read_fn read;                                   ///< Read function.
+    void *user;                                     ///< Read user data.
+    char buf[STREAM_BUF_SIZE];                      ///< Input buffer.
+    int pos;                                        ///< Input buffer pos.
+    int len;                                        ///< Input buffer size.
+    int eof;                                        ///< Whether input ends.
+    char tokens[2][STREAM_TOKEN_MAX_SIZE];          ///< Token buffers.
+    int which;                                      ///< Next token buffer.
+} option_stream;
+
+#ifdef USING_MINIOPT_MMAP
+/**
+ * @brief Memory-mapped file.
+ */
+typedef struct option_map_ {
+    char *data;             ///< File data.
+    size_t size;            ///< File size.
+    size_t mapsize;         ///< Mapping size, it is more than file size.
+} option_map;
+#endif
+
+/**
+ * @brief Option spec, it is the compiled option array.
+ * 
+ * It is immutable after miniopt_spec_init(), so many option_context(s) in
+ * many threads can share it.
+ */
+typedef struct option_spec_ {
+    option *opts;                       ///< Option array.
+    int optsum;                         ///< Option array size.
+    lookup_fn lookup;                   ///< User long name lookup function.
+
+    const int *shortIndex;              ///< Short name to option index, or -1.
+    const unsigned char *shortHasArg;   ///< Bitset of short names have arg.
+    int shortSlots[256];                ///< Built short name slots.
+    unsigned char shortArgBits[32];     ///< Built short name arg bitset.
+
+    option_allocator alloc;             ///< Allocator of a big long index.
+    int *longIndex;                     ///< Long name hash slots, or -1.
+    unsigned int longMask;              ///< Long name hash slot size - 1.
+    void *longBuf;                      ///< Allocated long index, or nil.
+    /// Inline long name hash slots.
+    int longSlots[LONG_INDEX_INLINE_SIZE];
+    int listed;                         ///< Whether there is a list option.
+    option_layout layout;               ///< Help text column layout.
+    const int *envIndex;                ///< Env name hash slots, or -1.
+    unsigned int envMask;               ///< Env name hash slot size - 1.
+    int envSlots[ENV_INDEX_MAX_SIZE];   ///< Built env name hash slots.
+    int envIndexed;                     ///< Whether there is an env name.
+    const option_command *commands;     ///< Subcommand array, or nil.
+    int commandsum;                     ///< Subcommand sum.
+    /// Subcommand name hash slots, or -1.
+    int commandIndex[COMMAND_INDEX_MAX_SIZE];
+#ifdef USING_MINIOPT_ABBREV
+    option_trie_node trie[ABBREV_NODE_MAX_SIZE];    ///< Long name trie.
+    int trieSize;                       ///< Trie node sum.
+#endif
+#ifdef USING_MINIOPT_SIMD
+    option_name *longNames;             ///< Names of the long name slots.
+    /// Zero padded long names of the inline hash slots.
+    MINIOPT_ALIGN(32) option_name longNameSlots[LONG_INDEX_INLINE_SIZE];
+#endif
+
+    int ruled;                          ///< Whether there is a rule.
+    int rulebits;                       ///< Options used by the rules.
+    /// Option index of each rule bit.
+    int ruleOptinds[RULE_OPTION_MAX_SIZE];
+    /// Option index hash slots of the rule bits, or -1.
+    int ruleSlots[RULE_INDEX_SIZE];
+    /// Options must be given.
+    unsigned long long required[RULE_WORD_SIZE];
+    /// Options have a requires rule.
+    unsigned long long needing[RULE_WORD_SIZE];
+    /// Options each option requires.
+    unsigned long long needs[RULE_OPTION_MAX_SIZE][RULE_WORD_SIZE];
+    /// Options each option cannot be used with.
+    unsigned long long excludes[RULE_OPTION_MAX_SIZE][RULE_WORD_SIZE];
+
+    const char *error;                  ///< Init error message.
+    char errbuf[ERROR_STR_MAX_SIZE];    ///< Init error message buffer.
+} option_spec;
+
+/**
+ * @brief Option context, it is the parsing state of one argument array.
+ */
+typedef struct option_context_ {
+    const option_spec *spec;            ///< Option spec.
+
+    int argc;                           ///< Command line arg size.
+    char **argv;                        ///< Command line args.
+    source_fn source;                   ///< Token source, or use argv.
+    void *user;                         ///< Token source user data.
+
+    int optind;                         ///< Current option index;
+    const char *optarg;                 ///< Current opt-arg or non-opt-arg.
+    int optargsize;                     ///< Size of optarg, -1 if unknown.
+    option_view optname;                ///< Current option name.
+    option_error err;                   ///< Current error;
+    const char *error;                  ///< Formatted error message, or nil.
+
+    int index;                          ///< Current parsing index to argv.
+    int argind;                         ///< Argv index of current option.
+    option_view peek;                   ///< Peeked next token.
+    int peeked;                         ///< Whether next token is peeked.
+    const char *token;                  ///< Current parsing token.
+    const char *it;                     ///< Forward iterator to the token.
+    int state;                          ///< Current parsing state.
+    unsigned long long seen[RULE_WORD_SIZE];    ///< Options have been got.
+    option_allocator alloc;             ///< Allocator of dynamic memory.
+    option_list_node *last;             ///< Last list value node.
+    int listDone;                       ///< Whether lists are finished.
+    const char **fallbacks;             ///< Config and env values.
+    int fallbackNext;                   ///< Next option index to deliver.
+    int command;                        ///< Subcommand index, or -1.
+    int commandChecked;                 ///< Whether first arg is checked.
+    int commandPending;                 ///< Whether to switch subcommand.
+    option_spec *subspec;               ///< Subcommand spec, or nil.
+    option_spec *subspecBuf;            ///< Caller subcommand spec, or nil.
+    void *subspecMem;                   ///< Allocated subcommand spec memory.
+    char **envp;                        ///< Env of miniopt_ctx_setenv().
+    const char *envprefix;              ///< Env name prefix.
+
+    char errbuf[ERROR_STR_MAX_SIZE];    ///< Error message buffer.
+
+#ifdef USING_MINIOPT_MMAP
+    char *rspIt;                        ///< Response file token iterator.
+    char *rspEnd;                       ///< Response file end.
+    option_map maps[RESPONSE_FILE_MAX_SIZE]; ///< Response file mappings.
+    int mapsum;                         ///< Response file mapping sum.
+    const char *configPath;             ///< Config file path.
+    char *configIt;                     ///< First config section, or nil.
+    char *configEnd;                    ///< Config file end.
+    int configLine;                     ///< Line number of configIt.
+#endif
+} option_context;
+
+/**
+ * @brief Initialize an option spec.
+ *
+ * @param[out] spec     Option spec to initialize.
+ * @param[in] opts      Option array.
+ * @param[in] optsum    Option sum of the option array.
+ * @param[in] lookup    User long name lookup function, it can be nil.
+ *
+ * @return 0            Init pass.
+ * @return other        Init error, see miniopt_spec_what().
+ */
+int miniopt_spec_init(option_spec *spec, option *opts, int optsum,
+                      lookup_fn lookup);
+
+/**
+ * @brief Initialize an option spec with an allocator.
+ *
+ * miniopt_spec_init() uses the default allocator(none, or
+ * miniopt_heap_alloc_fn with USING_MINIOPT_HEAP). The allocator is used
+ * only if the long names are more than LONG_INDEX_INLINE_SIZE / 2, see
+ * miniopt_spec_release().
+ *
+ * @return 0            Init pass.
+ * @return other        Init error, see miniopt_spec_what().
+ */
+int miniopt_spec_init_alloc(option_spec *spec, option *opts, int optsum,
+                            lookup_fn lookup, alloc_fn fn, void *user);
+
+/**
+ * @brief Release the memory got by an option spec, use it before the spec
+ * is initialized again or dropped.
+ */
+void miniopt_spec_release(option_spec *spec);
+
+/**
+ * @brief Initialize an option spec from a prevalidated option array.
+ *
+ * The option array should be checked at build time, by
+ * miniopt_static_check() in C++ or by the code generator, so the option
+ * checks and the lookup function check are skipped, only the indexes are
+ * built.
+ *
+ * @return 0            Init pass.
+ * @return other        Init error, see miniopt_spec_what().
+ */
+int miniopt_spec_init_prevalidated(option_spec *spec, option *opts,
+                                   int optsum, lookup_fn lookup);
+
+/**
+ * @brief Initialize an option spec from a prevalidated option array and its
+ * prebuilt tables.
+ *
+ * The short and env name indexes are the tables, the long name index is
+ * the lookup function(it should not be nil, or the long index is built), so
+ * init does not walk the option array. With USING_MINIOPT_ABBREV the long
+ * name trie is still built.
+ *
+ * @return 0            Init pass.
+ * @return other        Init error, see miniopt_spec_what().
+ */
+int miniopt_spec_init_tables(option_spec *spec, option *opts, int optsum,
+                             lookup_fn lookup, const option_tables *tables);
+
+/**
+ * @brief Get the name indexes of an initialized option spec, they can be
+ * emitted as the prebuilt tables of the same option array.
+ *
+ * The tables point into the spec.
+ */
+void miniopt_spec_tables(const option_spec *spec, option_tables *tables);
+
+/**
+ * @brief Get option spec init error str.
+ *
+ * @return not NULL     An error str.
+ * @return NULL         No error.
+ */
+const char *miniopt_spec_what(const option_spec *spec);
+
+/**
+ * @brief Add subcommands into the option spec.
+ * 
+ * It should be used after miniopt_spec_init() pass. The names are hashed,
+ * the option arrays are not checked until a subcommand is invoked. Only the
+ * first non-option-argument is looked up as a subcommand. A subcommand spec
+ * is allocated by the context allocator, see miniopt_ctx_setalloc().
+ * 
+ * @param[in,out] spec  Option spec.
+ * @param[in] cmds      Subcommand array, it should be valid until parsing
+ *                      finishes.
+ * @param[in] cmdsum    Subcommand sum of the subcommand array.
+ * 
+ * @return 0            Add pass.
+ * @return other        A name is not valid or used more than once, see
+ *                      miniopt_spec_what().
+ */
+int miniopt_spec_commands(option_spec *spec, const option_command *cmds,
+                          int cmdsum);
+
+/**
+ * @brief Get current subcommand index, see miniopt_command.
+ */
+int miniopt_ctx_command(const option_context *ctx);
+
+/**
+ * @brief Set the storage of the subcommand spec.
+ *
+ * It should be used after miniopt_ctx_init(). Only one subcommand is active
+ * at a time, so one spec is enough. Without it the spec is got from the
+ * context allocator(sizeof(option_spec) + 31 bytes).
+ *
+ * @param[in] ctx       Option context.
+ * @param[in] subspec   Subcommand spec storage, nil to use the allocator.
+ */
+void miniopt_ctx_setsubspec(option_context *ctx, option_spec *subspec);
+
+/**
+ * @brief Compile option rules into the option spec.
+ * 
+ * It should be used after miniopt_spec_init() pass, see option_rule.
+ * 
+ * @param[in,out] spec  Option spec.
+ * @param[in] rules     Rule array.
+ * @param[in] rulesum   Rule sum of the rule array.
+ * 
+ * @return 0            Compile pass.
+ * @return other        A rule is not valid, see miniopt_spec_what().
+ */
+int miniopt_spec_rules(option_spec *spec, const option_rule *rules,
+                       int rulesum);
+
+/**
+ * @brief Print the option array of the option spec.
+ * 
+ * @param[in] spec          Option spec.
+ * @param[in] printf_       User provide printf function.
+ * @param[in] indention     Print indention at the line beginning.
+ */
+void miniopt_spec_printopts(const option_spec *spec, printf_fn printf_,
+                            int indention);
+
+/**
+ * @brief Write function declaration, it is a sink of the help text.
+ * 
+ * @param[in] user      User data.
+ * @param[in] buf       Text to write, it is not terminated by '\0'.
+ * @param[in] size      Text size.
+ * 
+ * @return size         Write pass.
+ * @return other        Write error.
+ */
+typedef int (*write_fn)(void *user, const char *buf, int size);
+
+/**
+ * @brief Render the help text of the option array into a buffer.
+ * 
+ * The column layout is got by init, in the pass builds the short name index.
+ * 
+ * @param[in] spec          Option spec.
+ * @param[in] indention     Indention at the line beginning.
+ * @param[out] buf          Output buffer, the text is terminated by '\0'.
+ * @param[in] bufsize       Output buffer size.
+ * 
+ * @return int >= 0         The text size(without '\0'), the text is cut if
+ *                          it is not less than bufsize.
+ */
+int miniopt_spec_render(const option_spec *spec, int indention, char *buf,
+                        int bufsize);
+
+/**
+ * @brief Render the help text of the option array to a sink.
+ * 
+ * The text is written in chunks of HELP_BUF_SIZE, so it is one write if the
+ * text fits in it.
+ * 
+ * @param[in] spec          Option spec.
+ * @param[in] indention     Indention at the line beginning.
+ * @param[in] write         Sink function.
+ * @param[in] user          Sink user data.
+ * 
+ * @return 0                Write pass.
+ * @return -1               The sink fails.
+ */
+int miniopt_spec_writeopts(const option_spec *spec, int indention,
+                           write_fn write, void *user);
+
+/**
+ * @brief Initialize an option context.
+ *
+ * @param[out] ctx      Option context to initialize.
+ * @param[in] spec      Option spec, it should be initialized pass.
+ * @param[in] argc      Argument array size.
+ * @param[in] argv      Argument array.
+ */
+void miniopt_ctx_init(option_context *ctx, const option_spec *spec, int argc,
+                      char **argv);
+
+/**
+ * @brief Initialize an option context reads tokens from a token source.
+ * 
+ * The argument array is not used, and all the tokens from the source are
+ * args(no program path). A token is only valid until the source reads the
+ * tokens after it, so the bound STRING and LIST values and the parseall
+ * arguments are copied by the context allocator(they need one).
+ *
+ * @param[out] ctx      Option context to initialize.
+ * @param[in] spec      Option spec, it should be initialized pass.
+ * @param[in] source    Token source.
+ * @param[in] user      User data of the token source.
+ */
+void miniopt_ctx_init_source(option_context *ctx, const option_spec *spec,
+                             source_fn source, void *user);
+
+/**
+ * @brief Initialize a NUL-delimited token stream.
+ *
+ * @param[out] stream   Token stream to initialize.
+ * @param[in] read      Read function.
+ * @param[in] user      User data of the read function.
+ */
+void miniopt_stream_init(option_stream *stream, read_fn read, void *user);
+
+/**
+ * @brief Token source of a NUL-delimited token stream.
+ * 
+ * Use it with miniopt_ctx_init_source(ctx, spec, miniopt_stream_source,
+ * &stream), the token size cannot more than STREAM_TOKEN_MAX_SIZE - 1.
+ *
+ * @param[in] user      The option_stream.
+ * @param[out] token    Output token.
+ *
+ * @return 1            Get a token.
+ * @return 0            No more token.
+ * @return -1           Read error, or the token is too long.
+ */
+int miniopt_stream_source(void *user, option_view *token);
+
+/**
+ * @brief Release the resources of an option context.
+ * 
+ * It unmaps the response files, so the args from them cannot be used any
+ * more, and frees the list value nodes of a stopped parse by the allocator.
+ * Use it before init the context again or drop it.
+ *
+ * @param[in] ctx       Option context.
+ */
+void miniopt_ctx_release(option_context *ctx);
+
+/**
+ * @brief Set the allocator of an option context.
+ * 
+ * It should be used after miniopt_ctx_init(), see alloc_fn. The default one
+ * is none(miniopt_heap_alloc_fn with USING_MINIOPT_HEAP).
+ *
+ * @param[in] ctx       Option context.
+ * @param[in] fn        Allocator function, nil for no allocator.
+ * @param[in] user      User data of the allocator function.
+ */
+void miniopt_ctx_setalloc(option_context *ctx, alloc_fn fn, void *user);
+
+/**
+ * @brief Set an arena as the allocator of an option context.
+ *
+ * @param[in] ctx       Option context.
+ * @param[in] arena     Arena, nil for no allocator.
+ */
+void miniopt_ctx_setarena(option_context *ctx, option_arena *arena);
+
+/**
+ * @brief Fill the options not given by argv from environment variables.
+ * 
+ * It should be used after miniopt_ctx_init() and miniopt_ctx_setalloc(). The
+ * env is scanned once, each "PREFIX" + option.env entry is found by a hash
+ * index, the values are delivered by getopt after argv options(an option in
+ * argv overrides its env value). A value of an option has no argument is
+ * delivered if it is not "", "0", "false" or "no". The env is scanned for
+ * the subcommand options again when a subcommand is invoked.
+ *
+ * @param[in] ctx       Option context.
+ * @param[in] envp      Environment variables("KEY=value"), nil terminated.
+ * @param[in] prefix    Name prefix of the env names, it can be nil.
+ * 
+ * @return MINIOPT_PASS     Scan pass.
+ * @return MINIOPT_ERROR    The allocator cannot allocate, see
+ *                          miniopt_ctx_what().
+ */
+int miniopt_ctx_setenv(option_context *ctx, char **envp, const char *prefix);
+
+#ifdef USING_MINIOPT_MMAP
+/**
+ * @brief Fill the options not given by env or argv from a config file.
+ * 
+ * It should be used after miniopt_ctx_init() and miniopt_ctx_setalloc(), and
+ * before miniopt_ctx_setenv(), so the precedence is file < env < argv. The
+ * file is mapped like a response file and tokenized in place. Each line is
+ * "key = value", "# comment" or blank, the key is a long name, the value
+ * can be quoted by '"', and the last line of a key wins. The errors carry
+ * the file and line, see option_error. The keys before the first "[name]"
+ * line are of this spec, a "[name]" section is of the subcommand name, it
+ * is parsed when the subcommand is invoked.
+ *
+ * @param[in] ctx       Option context.
+ * @param[in] path      Config file path.
+ * 
+ * @return MINIOPT_PASS     Parse pass.
+ * @return MINIOPT_ERROR    The file cannot be read, a line is wrong, or the
+ *                          allocator cannot allocate, see miniopt_ctx_what().
+ */
+int miniopt_ctx_setconfig(option_context *ctx, const char *path);
+#endif
+
+/**
+ * @brief Initialize an arena on a caller buffer.
+ *
+ * @param[out] arena    Arena.
+ * @param[in] buf       Arena buffer.
+ * @param[in] size      Arena buffer size.
+ */
+void miniopt_arena_init(option_arena *arena, void *buf, int size);
+
+/**
+ * @brief Allocate from an arena, it is aligned to pointer size.
+ *
+ * @param[in] arena     Arena.
+ * @param[in] size      Bytes to allocate.
+ *
+ * @return not nil      Allocated memory.
+ * @return nil          The arena is full.
+ */
+void *miniopt_arena_alloc(option_arena *arena, int size);
+
+/**
+ * @brief Free all the memory allocated from an arena.
+ *
+ * @param[in] arena     Arena.
+ */
+void miniopt_arena_reset(option_arena *arena);
+
+/**
+ * @brief Arena allocator function, user is an option_arena.
+ */
+void *miniopt_arena_alloc_fn(void *user, void *ptr, int size);
+
+#ifdef USING_MINIOPT_HEAP
+/**
+ * @brief Heap allocator function by malloc() and free(), user is unused.
+ */
+void *miniopt_heap_alloc_fn(void *user, void *ptr, int size);
+#endif
+
+/**
+ * @brief Initialize a fixed-block pool on a caller buffer.
+ *
+ * @param[out] pool     Pool.
+ * @param[in] buf       Pool buffer.
+ * @param[in] size      Pool buffer size.
+ * @param[in] blockSize Block size, it is rounded up to pointer size.
+ */
+void miniopt_pool_init(option_pool *pool, void *buf, int size, int blockSize);
+
+/**
+ * @brief Allocate a block from a pool.
+ *
+ * @param[in] pool      Pool.
+ *
+ * @return not nil      Allocated block.
+ * @return nil          The pool is full.
+ */
+void *miniopt_pool_alloc(option_pool *pool);
+
+/**
+ * @brief Free a block to a pool.
+ *
+ * @param[in] pool      Pool.
+ * @param[in] ptr       Block allocated from the pool.
+ */
+void miniopt_pool_free(option_pool *pool, void *ptr);
+
+/**
+ * @brief Pool allocator function, user is an option_pool.
+ * 
+ * It cannot allocate more than the block size each time.
+ */
+void *miniopt_pool_alloc_fn(void *user, void *ptr, int size);
+
+/**
+ * @brief Get next option, see miniopt_getopt.
+ */
+int miniopt_ctx_getopt(option_context *ctx);
+
+/**
+ * @brief Parse all the args into the result arrays, see miniopt_parseall.
+ */
+int miniopt_ctx_parseall(option_context *ctx, option_result *result,
+                         int *size);
+
+/**
+ * @brief Get current option index, see miniopt_optind.
+ */
+int miniopt_ctx_optind(const option_context *ctx);
+
+/**
+ * @brief Get current option-argument or non-option-argument, see 
+ * miniopt_optarg.
+ */
+const char *miniopt_ctx_optarg(const option_context *ctx);
+
+/**
+ * @brief Get current argument as a string view, see miniopt_optargview.
+ */
+option_view miniopt_ctx_optarg_view(option_context *ctx);
+
+/**
+ * @brief Get current option name as a string view, see miniopt_optnameview.
+ */
+option_view miniopt_ctx_optname_view(const option_context *ctx);
+
+/**
+ * @brief Get current error str, see miniopt_what.
+ *
+ * The message is formatted from the structured error at the first call.
+ */
+const char *miniopt_ctx_what(option_context *ctx);
+
+/**
+ * @brief Get current error, see miniopt_error.
+ */
+const option_error *miniopt_ctx_error(const option_context *ctx);
+
+/**
+ * @brief Suggest the closest long names for an unknown option error.
+ *
+ * It is computed when it is called(what() calls it to add "Did you mean"
+ * with SUGGEST_MAX_SIZE names). The long names out of the length window or
+ * the char signature bound are skipped, the others are compared by
+ * bit-parallel edit distance.
+ *
+ * @param[in] ctx           Option context.
+ * @param[out] optinds      Option indexes of the names, the closest first.
+ * @param[in] size          Max names, at most SUGGEST_MAX_SIZE are got.
+ *
+ * @return int >= 0         Names got, 0 is no suggestion.
+ */
+int miniopt_ctx_suggest(const option_context *ctx, int *optinds, int size);
+
+/**
+ * @brief Convert current argument to an integer, see miniopt_optint.
+ */
+int miniopt_ctx_int(option_context *ctx, long long min, long long max,
+                    long long *value);
+
+/**
+ * @brief Convert current argument to a float, see miniopt_optfloat.
+ */
+int miniopt_ctx_float(option_context *ctx, double *value);
+
+/**
+ * @brief Convert current argument to a byte size, see miniopt_optsize.
+ */
+int miniopt_ctx_size(option_context *ctx, unsigned long long *value);
+
+/**
+ * @brief Convert current argument to a duration, see miniopt_optduration.
+ */
+int miniopt_ctx_duration(option_context *ctx, unsigned long long *value);
+
+/**
+ * @brief Parse a string without an option context, they return 0(pass),
+ * -1(not valid) or -2(out of range).
+ */
+int miniopt_parse_int(const char *s, long long *value);
+int miniopt_parse_float(const char *s, double *value);
+int miniopt_parse_size(const char *s, unsigned long long *value);
+int miniopt_parse_duration(const char *s, unsigned long long *value);
+
 #ifdef __cplusplus
 }
+#endif
+
+#if defined(__cplusplus) && (__cplusplus >= 201402L || \
+    (defined(_MSVC_LANG) && _MSVC_LANG >= 201402L))
+//
+// Compile time option array checks(C++14), they are the same as the checks
+// of miniopt_spec_init(), so a checked array can be used by
+// miniopt_spec_init_prevalidated() or miniopt.setprevalidated(1).
+//
+//     static constexpr option options[] = {...};
+//     static_assert(miniopt_static_check(options) < 0, "bad options.");
+//
+
+/**
+ * @brief Get string length at compile time, nil is 0.
+ */
+constexpr int miniopt_static_strlen(const char *s) {
+    int size = 0;
+    while (s && s[size]) ++size;
+    return size;
+}
+
+/**
+ * @brief Check whether two strings are the same at compile time.
+ *
+ * @return true     Both are not nil and the same.
+ */
+constexpr bool miniopt_static_same(const char *s1, const char *s2) {
+    if (s1 == nil || s2 == nil) return false;
+    while (*s1 && *s1 == *s2) {
+        ++s1;
+        ++s2;
+    }
+    return *s1 == *s2;
+}
+
+/**
+ * @brief Check whether a string uses a char at compile time.
+ */
+constexpr bool miniopt_static_find(const char *s, char c) {
+    while (s && *s) {
+        if (*s++ == c) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Get the common prefix size of two strings at compile time.
+ */
+constexpr int miniopt_static_common(const char *s1, const char *s2) {
+    int size = 0;
+    while (s1 && s2 && s1[size] && s1[size] == s2[size]) ++size;
+    return size;
+}
+
+/**
+ * @brief Check an option at compile time, see miniopt_simple_check().
+ *
+ * @return true     Check pass.
+ */
+constexpr bool miniopt_static_check_opt(const option &opt) {
+    if (opt.sname == nil && opt.lname == nil) return false;
+    if (opt.sname == '-' || opt.sname == '=') return false;
+    if (opt.lname && (opt.lname[0] == '-' ||
+                      miniopt_static_find(opt.lname, '='))) {
+        return false;
+    }
+    if (miniopt_static_strlen(opt.lname) > OPTION_NAME_MAX_SIZE) return false;
+    if (opt.env && (opt.env[0] == '\0' || miniopt_static_find(opt.env, '='))) {
+        return false;
+    }
+
+    const bool hasArg = opt.ahint != nil;
+    switch (opt.kind) {
+        case MINIOPT_KIND_NONE:
+            return true;
+        case MINIOPT_KIND_FLAG:
+        case MINIOPT_KIND_COUNTER:
+            return opt.dest != nil && !hasArg;
+        case MINIOPT_KIND_STRING:
+        case MINIOPT_KIND_INT:
+        case MINIOPT_KIND_LIST:
+            return opt.dest != nil && hasArg;
+        case MINIOPT_KIND_CALLBACK:
+            return opt.dest != nil;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Check an option array at compile time.
+ *
+ * Names are compared pairwise, it is only paid by the compiler. It checks
+ * each option, the names used by more than one option, and the env name
+ * sum(ENV_INDEX_MAX_SIZE / 2). With USING_MINIOPT_ABBREV, it checks the
+ * trie node sum(ABBREV_NODE_MAX_SIZE) too, so it rejects all the option
+ * arrays init rejects. It cannot check the lookup function(the prevalidated
+ * init does not call it), and the long index memory of more than
+ * LONG_INDEX_INLINE_SIZE / 2 long names is still got at run time.
+ *
+ * @param[in] opts      Option array.
+ * @param[in] optsum    Option sum of the option array.
+ *
+ * @return -1           Check pass.
+ * @return [0, optsum-1] The first option index which is not valid, or uses
+ *                      a name of an option before it.
+ */
+constexpr int miniopt_static_check(const option *opts, int optsum) {
+    int envsum = 0;
+#ifdef USING_MINIOPT_ABBREV
+    int nodesum = 1;
+#endif
+    for (int i = 0; i < optsum; ++i) {
+        if (!miniopt_static_check_opt(opts[i])) return i;
+        if (opts[i].env && ++envsum > ENV_INDEX_MAX_SIZE / 2) return i;
+        for (int j = 0; j < i; ++j) {
+            if ((opts[i].sname != nil && opts[i].sname == opts[j].sname) ||
+                miniopt_static_same(opts[i].lname, opts[j].lname) ||
+                miniopt_static_same(opts[i].env, opts[j].env)) {
+                return i;
+            }
+        }
+#ifdef USING_MINIOPT_ABBREV
+        // The trie nodes of the name which are not shared with a name before
+        // it.
+        int common = 0;
+        for (int j = 0; opts[i].lname && j < i; ++j) {
+            const int size = miniopt_static_common(opts[i].lname,
+                                                   opts[j].lname);
+            if (size > common) common = size;
+        }
+        nodesum += miniopt_static_strlen(opts[i].lname) - common;
+        if (nodesum > ABBREV_NODE_MAX_SIZE) return i;
+#endif
+    }
+    return optsum > 0 ? -1 : 0;
+}
+
+/**
+ * @brief Check an option array at compile time, see miniopt_static_check().
+ */
+template <int N>
+constexpr int miniopt_static_check(const option (&opts)[N]) {
+    return miniopt_static_check(opts, N);
+}
 #endif
\ No newline at end of file
@@ -0,0 +1,138 @@
+/**
+ * The MIT License
+ *
+ * Copyright 2022 Krishna sssky307@163.com
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+/**
+ * Benchmark option lookup.
+ * 
+ * The default long name index is compared with a linear search, which is
+ * plugged in as a user lookup function.
+ */
+
+#include "miniopt.h"
+#include <stdio.h>
+#include <time.h>
+
+#define MAX_OPTSUM 10000
+#define TOKEN_SUM 4096
+#define ROUND_SUM 64
+#define LINEAR_ROUND_SUM 4
+// Memory of the long index(and the SIMD name table) of MAX_OPTSUM options.
+#define ARENA_SIZE (2 << 20)
+
+static char names[MAX_OPTSUM][OPTION_NAME_MAX_SIZE + 1];
+static char tokens[TOKEN_SUM][OPTION_NAME_MAX_SIZE + 3];
+static option options[MAX_OPTSUM];
+static char *argv[TOKEN_SUM + 1];
+static int benchOptsum;
+static char arenaBuf[ARENA_SIZE];
+static option_arena arena;
+
+// The linear search baseline, it compares the name with every option.
+static int LinearLookup(const char *beg, const char *end) {
+    for (int i = 0; i < benchOptsum; ++i) {
+        const char *name = options[i].lname;
+        const char *it = beg;
+        while (it < end && *it == *name) {
+            ++it;
+            ++name;
+        }
+        if (it == end && *name == '\0') return i;
+    }
+    return -1;
+}
+
+// A simple random number generator, so the result is repeatable.
+static unsigned int next_random() {
+    static unsigned int seed = 12345;
+    seed = seed * 1103515245u + 12345u;
+    return (seed >> 16) & 0x7fff;
+}
+
+static void make_options(int optsum) {
+    static const char *words[] = {"enable", "disable", "output", "input",
+                                  "max",    "min",     "list",   "level"};
+    const int wordsum = sizeof(words) / sizeof(words[0]);
+
+    for (int i = 0; i < optsum; ++i) {
+        snprintf(names[i], sizeof(names[i]), "%s-%s-%d",
+                 words[i % wordsum], words[(i / wordsum) % wordsum], i);
+        options[i].lname = names[i];
+        options[i].desc = "benchmark option.";
+    }
+}
+
+static void make_tokens(int optsum) {
+    argv[0] = (char *)"bench";
+    for (int i = 0; i < TOKEN_SUM; ++i) {
+        snprintf(tokens[i], sizeof(tokens[i]), "--%s",
+                 names[next_random() % optsum]);
+        argv[i + 1] = tokens[i];
+    }
+}
+
+static int run(int optsum, lookup_fn lookup, int roundSum, double *initNs,
+               double *tokenNs) {
+    option_spec spec;
+    option_context ctx;
+    clock_t initClock = 0;
+    clock_t getoptClock = 0;
+    benchOptsum = optsum;
+    for (int round = 0; round < roundSum; ++round) {
+        miniopt_arena_reset(&arena);
+        clock_t begin = clock();
+        if (miniopt_spec_init_alloc(&spec, options, optsum, lookup,
+                                    miniopt_arena_alloc_fn, &arena) != 0) {
+            printf("error: %s\n", miniopt_spec_what(&spec));
+            return -1;
+        }
+        miniopt_ctx_init(&ctx, &spec, TOKEN_SUM + 1, argv);
+        clock_t middle = clock();
+        while (miniopt_ctx_getopt(&ctx) > 0) {}
+        clock_t end = clock();
+        miniopt_spec_release(&spec);
+
+        initClock += middle - begin;
+        getoptClock += end - middle;
+    }
+
+    *initNs = (double)initClock * 1e9 / CLOCKS_PER_SEC / roundSum;
+    *tokenNs = (double)getoptClock * 1e9 / CLOCKS_PER_SEC /
+               ((double)roundSum * TOKEN_SUM);
+    return 0;
+}
+
+int main() {
+    const int optsumArray[] = {10, 50, 100, 300, 500, 1000, 4000, 10000};
+    const int size = sizeof(optsumArray) / sizeof(optsumArray[0]);
+
+#ifdef USING_MINIOPT_SIMD
+    printf("USING_MINIOPT_SIMD\n");
+#endif
+    printf("LONG_INDEX_INLINE_SIZE = %d\n", LONG_INDEX_INLINE_SIZE);
+    miniopt_arena_init(&arena, arenaBuf, sizeof(arenaBuf));
+    printf("%10s %16s %16s %16s\n", "optsum", "init(ns)",
+           "getopt(ns/token)", "linear(ns/token)");
+    for (int i = 0; i < size; ++i) {
+        double initNs = 0;
+        double tokenNs = 0;
+        double linearInitNs = 0;
+        double linearNs = 0;
+        make_options(optsumArray[i]);
+        make_tokens(optsumArray[i]);
+        if (run(optsumArray[i], nil, ROUND_SUM, &initNs, &tokenNs) != 0 ||
+            run(optsumArray[i], LinearLookup, LINEAR_ROUND_SUM, &linearInitNs,
+                &linearNs) != 0) {
+            return 1;
+        }
+        printf("%10d %16.0f %16.1f %16.1f\n", optsumArray[i], initNs,
+               tokenNs, linearNs);
+    }
+
+    return 0;
+}
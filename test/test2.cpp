@@ -10,6 +10,13 @@
 #define USING_MINIOPT_ASSERT
 #include "miniopt.h"
 #include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <cstdarg>
+#include <cstring>
 
 const char *argv[] = {"/path/to/myapp.exe",
                       "-a",
@@ -40,20 +47,99 @@ const char *argv[] = {"/path/to/myapp.exe",
                       "-vhv"};
 int argc = sizeof(argv) / sizeof(argv[0]);
 
-int main() {
-    option options[] = {
-        {'a', "append", "<file>", "append file."},    // -a, --append
-        {'r', "remove", "<file>", "remove file."},    // -r, --remove
-        {'h', "help", nil, "show help."},             // -h, --help
-        {nil, "debug", nil, "enable debug."},         //     --debug
-        {'v', nil, nil,
-         "show version with"                          // -v
-         "<br>comment line 2."}};
-    const int optsum = sizeof(options) / sizeof(options[0]);
+// The args(except the path) as a NUL-delimited stream.
+struct Input {
+    std::string data;
+    std::size_t pos = 0;
+};
+
+// Read at most 3 bytes each time, so tokens cross the buffer boundary.
+int ReadInput(void *user, char *buf, int size) {
+    Input *input = static_cast<Input *>(user);
+    int len = 0;
+    while (len < size && len < 3 && input->pos < input->data.size()) {
+        buf[len++] = input->data[input->pos++];
+    }
+    return len;
+}
+
+// Count the callback options.
+int CountCallback(void *user, option_context *ctx) {
+    (void)ctx;
+    ++*static_cast<int *>(user);
+    return MINIOPT_PASS;
+}
+
+// Append the help text to a std::string.
+int WriteHelp(void *user, const char *buf, int size) {
+    static_cast<std::string *>(user)->append(buf, size);
+    return size;
+}
+
+// A printf knows "%s" only.
+std::string printedHelp;
+int PrintHelp(char const *const format, ...) {
+    if (std::strcmp(format, "%s") != 0) return -1;
+    va_list args;
+    va_start(args, format);
+    printedHelp += va_arg(args, const char *);
+    va_end(args);
+    return 0;
+}
+
+// Checked at compile time, so the runtime checks are skipped.
+int staticVerbose = 0;
+constexpr option staticOpts[] = {
+    {'v', "verbose", nil, nil, MINIOPT_KIND_COUNTER, &staticVerbose, nil},
+    {'o', "out", "<file>", nil, MINIOPT_KIND_NONE, nil, nil},
+    {nil, "dry-run", nil, nil, MINIOPT_KIND_NONE, nil, "DRY_RUN"}};
+static_assert(miniopt_static_check(staticOpts) < 0, "options are bad.");
+
+// The first option index which is not valid is found.
+constexpr option staticDupOpts[] = {
+    {'a', "all", nil, nil, MINIOPT_KIND_NONE, nil, nil},
+    {'b', "all", nil, nil, MINIOPT_KIND_NONE, nil, nil}};
+constexpr option staticCharOpts[] = {
+    {'a', nil, nil, nil, MINIOPT_KIND_NONE, nil, nil},
+    {nil, "a=b", nil, nil, MINIOPT_KIND_NONE, nil, nil}};
+constexpr option staticKindOpts[] = {
+    {'c', nil, "<n>", nil, MINIOPT_KIND_COUNTER, &staticVerbose, nil}};
+constexpr option staticSizeOpts[] = {
+    {nil, "a-long-name-which-is-more-than-32-chars", nil, nil,
+     MINIOPT_KIND_NONE, nil, nil}};
+static_assert(miniopt_static_check(staticDupOpts) == 1, "dup is missed.");
+static_assert(miniopt_static_check(staticCharOpts) == 1, "char is missed.");
+static_assert(miniopt_static_check(staticKindOpts) == 0, "kind is missed.");
+static_assert(miniopt_static_check(staticSizeOpts) == 0, "size is missed.");
+#ifdef USING_MINIOPT_ABBREV
+constexpr option staticPrefixOpts[] = {
+    {nil, "all", nil, nil, MINIOPT_KIND_NONE, nil, nil},
+    {nil, "al", nil, nil, MINIOPT_KIND_NONE, nil, nil}};
+static_assert(miniopt_static_check(staticPrefixOpts) < 0,
+              "prefix is not accepted.");
+#endif
 
+option options[] = {
+    {'a', "append", "<file>", "append file.",     // -a, --append
+     MINIOPT_KIND_NONE, nil, nil},
+    {'r', "remove", "<file>", "remove file.",     // -r, --remove
+     MINIOPT_KIND_NONE, nil, nil},
+    {'h', "help", nil, "show help.",              // -h, --help
+     MINIOPT_KIND_NONE, nil, nil},
+    {nil, "debug", nil, "enable debug.",          //     --debug
+     MINIOPT_KIND_NONE, nil, nil},
+    {'v', nil, nil,
+     "show version with"                          // -v
+     "<br>comment line 2.",
+     MINIOPT_KIND_NONE, nil, nil}};
+const int optsum = sizeof(options) / sizeof(options[0]);
+
+// Each test returns 0 if it passes, or prints why and returns -1.
+
+int TestMiniopt() {
     if (miniopt.init(argc, (char **)argv, options, optsum) != 0) {
         printf("error: %s\n", miniopt.what());
-        return 0;
+        return -1;
     }
 
     int status;
@@ -89,7 +175,1015 @@ int main() {
     printf("\nOptions:\n");
     miniopt.printopts(printf, 2);
 
-    if (status == 0) printf("\n--test pass--\n");
-
     return status;
+}
+
+// Two contexts share one spec and parse the same args interleaved.
+int TestReentrant() {
+    option_spec spec;
+    option_context ctx1;
+    option_context ctx2;
+    if (miniopt_spec_init(&spec, options, optsum, nil) != 0) {
+        printf("error: %s\n", miniopt_spec_what(&spec));
+        return -1;
+    }
+    miniopt_ctx_init(&ctx1, &spec, argc, (char **)argv);
+    miniopt_ctx_init(&ctx2, &spec, argc, (char **)argv);
+
+    int status1;
+    int status2;
+    do {
+        status1 = miniopt_ctx_getopt(&ctx1);
+        status2 = miniopt_ctx_getopt(&ctx2);
+        if (status1 != status2 ||
+            miniopt_ctx_optind(&ctx1) != miniopt_ctx_optind(&ctx2) ||
+            miniopt_ctx_optarg(&ctx1) != miniopt_ctx_optarg(&ctx2)) {
+            printf("error: contexts are not the same.\n");
+            return -1;
+        }
+    } while (status1 > 0);
+
+    return status1;
+}
+
+// Parse all the args by a small result arrays, compare with getopt.
+int TestParseall() {
+    option_spec spec;
+    option_context ctx1;
+    option_context ctx2;
+    int optindArray[5];
+    int argindArray[5];
+    const char *optargArray[5];
+    option_result result = {optindArray, argindArray, optargArray, 5};
+    miniopt_spec_init(&spec, options, optsum, nil);
+    miniopt_ctx_init(&ctx1, &spec, argc, (char **)argv);
+    miniopt_ctx_init(&ctx2, &spec, argc, (char **)argv);
+
+    int status1;
+    int size;
+    do {
+        status1 = miniopt_ctx_parseall(&ctx1, &result, &size);
+        for (int i = 0; i < size; ++i) {
+            if (miniopt_ctx_getopt(&ctx2) <= 0 ||
+                optindArray[i] != miniopt_ctx_optind(&ctx2) ||
+                optargArray[i] != miniopt_ctx_optarg(&ctx2) ||
+                argindArray[i] < 1 || argindArray[i] >= argc) {
+                printf("error: parseall is not the same as getopt.\n");
+                return -1;
+            }
+        }
+    } while (status1 > 0);
+
+    if (status1 != 0 || miniopt_ctx_getopt(&ctx2) != 0) {
+        printf("error: parseall does not finish with getopt.\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Parse the args from a NUL-delimited stream, compare with argv.
+int TestStream() {
+    option_spec spec;
+    option_context ctx1;
+    option_context ctx2;
+    Input input;
+    for (int i = 1; i < argc; ++i) {
+        input.data += argv[i];
+        input.data += '\0';
+    }
+    static option_stream stream;
+    miniopt_spec_init(&spec, options, optsum, nil);
+    miniopt_stream_init(&stream, ReadInput, &input);
+    miniopt_ctx_init_source(&ctx1, &spec, miniopt_stream_source, &stream);
+    miniopt_ctx_init(&ctx2, &spec, argc, (char **)argv);
+
+    int status1;
+    int status2;
+    do {
+        status1 = miniopt_ctx_getopt(&ctx1);
+        status2 = miniopt_ctx_getopt(&ctx2);
+        const char *arg1 = miniopt_ctx_optarg(&ctx1);
+        const char *arg2 = miniopt_ctx_optarg(&ctx2);
+        // The stream knows the sizes, argv computes them, views should match.
+        option_view view1 = miniopt_ctx_optarg_view(&ctx1);
+        option_view view2 = miniopt_ctx_optarg_view(&ctx2);
+        option_view name1 = miniopt_ctx_optname_view(&ctx1);
+        option_view name2 = miniopt_ctx_optname_view(&ctx2);
+        if (status1 != status2 ||
+            miniopt_ctx_optind(&ctx1) != miniopt_ctx_optind(&ctx2) ||
+            (arg1 == nil) != (arg2 == nil) ||
+            (arg1 && std::string(arg1) != arg2) ||
+            (arg1 && (view1.size != view2.size ||
+                      view1.size != (int)std::string(arg1).size())) ||
+            std::string(name1.data ? name1.data : "", name1.size) !=
+                std::string(name2.data ? name2.data : "", name2.size)) {
+            printf("error: stream is not the same as argv.\n");
+            return -1;
+        }
+    } while (status1 > 0);
+    if (status1 != MINIOPT_FINISHED) return status1;
+
+    // The bound value and the parseall args are kept after next tokens.
+    const char *name = nil;
+    option nameOpts[] = {
+        {'n', "name", "<name>", nil, MINIOPT_KIND_STRING, &name, nil}};
+    char arenaBuf[256];
+    option_arena arena;
+    int optinds[8];
+    int arginds[8];
+    const char *optargs[8];
+    option_result result = {optinds, arginds, optargs, 8};
+    int size = 0;
+    const char streamData[] = "--name\0alice\0x\0y\0z";
+    input.data.assign(streamData, sizeof(streamData));
+    input.pos = 0;
+    miniopt_spec_init(&spec, nameOpts, 1, nil);
+    miniopt_stream_init(&stream, ReadInput, &input);
+    miniopt_ctx_init_source(&ctx1, &spec, miniopt_stream_source, &stream);
+    miniopt_arena_init(&arena, arenaBuf, sizeof(arenaBuf));
+    miniopt_ctx_setarena(&ctx1, &arena);
+    if (miniopt_ctx_parseall(&ctx1, &result, &size) != MINIOPT_FINISHED ||
+        size != 3 || name == nil || std::string(name) != "alice" ||
+        std::string(optargs[0]) != "x" || std::string(optargs[1]) != "y" ||
+        std::string(optargs[2]) != "z") {
+        printf("error: stream values are not kept.\n");
+        return -1;
+    }
+    return status1;
+}
+
+// Duplicate short or long names are rejected by init.
+int TestDuplicate() {
+    option_spec spec;
+    option dupShort[] = {{'a', "append", nil, nil, MINIOPT_KIND_NONE, nil, nil},
+                         {'a', "all", nil, nil, MINIOPT_KIND_NONE, nil, nil}};
+    option dupLong[] = {{'a', "append", nil, nil, MINIOPT_KIND_NONE, nil, nil},
+                        {'b', "append", nil, nil, MINIOPT_KIND_NONE, nil, nil}};
+    if (miniopt_spec_init(&spec, dupShort, 2, nil) == 0 ||
+        miniopt_spec_init(&spec, dupLong, 2, nil) == 0) {
+        printf("error: duplicate names are not detected.\n");
+        return -1;
+    }
+    printf("%s\n", miniopt_spec_what(&spec));
+    return miniopt_spec_init(&spec, options, optsum, nil);
+}
+
+// Errors are structured, the message is formatted by what().
+int TestError() {
+    option_spec spec;
+    option_context ctx1;
+    miniopt_spec_init(&spec, options, optsum, nil);
+    const char *badArgv[] = {"/path/to/myapp.exe", "-v", "--bogus"};
+    miniopt_ctx_init(&ctx1, &spec, 3, (char **)badArgv);
+    int status1;
+    while ((status1 = miniopt_ctx_getopt(&ctx1)) > 0) {}
+    const option_error *err = miniopt_ctx_error(&ctx1);
+    if (status1 != MINIOPT_ERROR || err->code != MINIOPT_ERR_UNKNOWN_OPTION ||
+        err->argind != 2 || err->optind != optsum ||
+        std::string(miniopt_ctx_what(&ctx1)) != "option --bogus is unknown.") {
+        printf("error: structured error is wrong.\n");
+        return -1;
+    }
+
+    // An unknown option gets the closest long names.
+    int optinds[SUGGEST_MAX_SIZE];
+    const char *typoArgv[] = {"/path/to/myapp.exe", "--apend=x"};
+    miniopt_ctx_init(&ctx1, &spec, 2, (char **)typoArgv);
+    if (miniopt_ctx_getopt(&ctx1) != MINIOPT_ERROR ||
+        miniopt_ctx_suggest(&ctx1, optinds, SUGGEST_MAX_SIZE) != 1 ||
+        optinds[0] != 0 ||
+        std::string(miniopt_ctx_what(&ctx1)) !=
+            "option --apend=x is unknown. Did you mean --append?") {
+        printf("error: suggestion is wrong.\n");
+        return -1;
+    }
+    // The closest first, "--limits" is one edit farther than the others.
+    option_spec typoSpec;
+    option typoOpts[] = {
+        {nil, "limits", nil, nil, MINIOPT_KIND_NONE, nil, nil},
+        {nil, "limit", nil, nil, MINIOPT_KIND_NONE, nil, nil},
+        {nil, "level", nil, nil, MINIOPT_KIND_NONE, nil, nil},
+        {nil, "list", nil, nil, MINIOPT_KIND_NONE, nil, nil},
+        {nil, "lint", nil, nil, MINIOPT_KIND_NONE, nil, nil}};
+    const char *typosArgv[] = {"/path/to/myapp.exe", "--limt"};
+    miniopt_spec_init(&typoSpec, typoOpts, 5, nil);
+    miniopt_ctx_init(&ctx1, &typoSpec, 2, (char **)typosArgv);
+    if (miniopt_ctx_getopt(&ctx1) != MINIOPT_ERROR ||
+        miniopt_ctx_suggest(&ctx1, optinds, 2) != 2 || optinds[0] != 1 ||
+        optinds[1] != 3 ||
+        std::string(miniopt_ctx_what(&ctx1)) !=
+            "option --limt is unknown. Did you mean --limit, --list or "
+            "--lint?") {
+        printf("error: suggestions are wrong: %s\n", miniopt_ctx_what(&ctx1));
+        return -1;
+    }
+    return 0;
+}
+
+// The help text rendered into a buffer is the same as the written one, a
+// small buffer gets the cut text and the full size.
+int TestRender() {
+    option_spec spec;
+    miniopt_spec_init(&spec, options, optsum, nil);
+    std::string help;
+    char helpBuf[1024];
+    char smallBuf[8];
+    miniopt_spec_writeopts(&spec, 2, WriteHelp, &help);
+    int helpSize = miniopt_spec_render(&spec, 2, helpBuf, sizeof(helpBuf));
+    if (help != helpBuf || helpSize != (int)help.size() ||
+        miniopt_spec_render(&spec, 2, smallBuf, sizeof(smallBuf)) !=
+            helpSize ||
+        help.compare(0, sizeof(smallBuf) - 1, smallBuf) != 0) {
+        printf("error: help render is wrong.\n");
+        return -1;
+    }
+    printedHelp.clear();
+    miniopt_spec_printopts(&spec, PrintHelp, 2);
+    if (printedHelp != help) {
+        printf("error: help print is wrong.\n");
+        return -1;
+    }
+    // Prebuilt tables without a layout get it computed by init.
+    option_spec tableSpec;
+    option_tables tables;
+    miniopt_spec_tables(&spec, &tables);
+    tables.layout.offset = 0;
+    miniopt_spec_init_tables(&tableSpec, options, optsum, nil, &tables);
+    if (miniopt_spec_render(&tableSpec, 2, helpBuf, sizeof(helpBuf)) !=
+            helpSize || help != helpBuf) {
+        printf("error: help layout of the tables is wrong.\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Typed arguments, the floats are compared with strtod.
+int TestTypedArgument() {
+    option_spec spec;
+    option_context ctx1;
+    long long i64;
+    double f64;
+    unsigned long long u64;
+    const char *floats[] = {"0", "-1.5", ".25", "2.5e-3", "1e22", "3.14159"};
+    for (auto str : floats) {
+        if (miniopt_parse_float(str, &f64) != 0 ||
+            f64 != std::strtod(str, nullptr)) {
+            printf("error: float %s is wrong.\n", str);
+            return -1;
+        }
+    }
+    // Long mantissa or big exponent is not exact, it is within 1e-15.
+    const char *roughFloats[] = {"123456789012345678901234", "1e-300"};
+    for (auto str : roughFloats) {
+        double expect = std::strtod(str, nullptr);
+        if (miniopt_parse_float(str, &f64) != 0 ||
+            std::abs(f64 - expect) > expect * 1e-15) {
+            printf("error: float %s is wrong.\n", str);
+            return -1;
+        }
+    }
+    if (miniopt_parse_int("-0x1f", &i64) != 0 || i64 != -31 ||
+        miniopt_parse_int("-9223372036854775808", &i64) != 0 ||
+        miniopt_parse_int("9223372036854775808", &i64) != -2 ||
+        miniopt_parse_int("12a", &i64) != -1 ||
+        miniopt_parse_float("1e400", &f64) != -2 ||
+        miniopt_parse_float("1.2.3", &f64) != -1 ||
+        miniopt_parse_size("64K", &u64) != 0 || u64 != 65536 ||
+        miniopt_parse_size("2GiB", &u64) != 0 || u64 != (2ull << 30) ||
+        miniopt_parse_size("16EB", &u64) != -1 ||
+        miniopt_parse_duration("250ms", &u64) != 0 || u64 != 250000000 ||
+        miniopt_parse_duration("1h30m", &u64) != 0 ||
+        u64 != 5400000000000ull ||
+        miniopt_parse_duration("5", &u64) != -1 ||
+        miniopt_parse_duration("0x5s", &u64) != -1 ||
+        miniopt_parse_duration("0xdh", &u64) != -1 ||
+        miniopt_parse_duration("1h0X5s", &u64) != -1) {
+        printf("error: typed argument parse is wrong.\n");
+        return -1;
+    }
+    miniopt_spec_init(&spec, options, optsum, nil);
+    const char *valueArgv[] = {"/path/to/myapp.exe", "-r", "42", "-r", "4x"};
+    miniopt_ctx_init(&ctx1, &spec, 5, (char **)valueArgv);
+    if (miniopt_ctx_getopt(&ctx1) != MINIOPT_PASS ||
+        miniopt_ctx_int(&ctx1, 0, 100, &i64) != MINIOPT_PASS || i64 != 42 ||
+        miniopt_ctx_int(&ctx1, 0, 10, &i64) != MINIOPT_ERROR ||
+        std::string(miniopt_ctx_what(&ctx1)) !=
+            "option --remove argument 42 is out of range.") {
+        printf("error: typed argument error is wrong.\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Bound options are stored by the parser, only "x" is returned.
+int TestBound() {
+    option_spec spec;
+    option_context ctx1;
+    int verbose = 0;
+    int debug = 0;
+    const char *file = nil;
+    long long level = 0;
+    int callbackSum = 0;
+    option_callback callback = {CountCallback, &callbackSum};
+    option bounds[] = {
+        {'v', nil, nil, nil, MINIOPT_KIND_COUNTER, &verbose, nil},
+        {nil, "debug", nil, nil, MINIOPT_KIND_FLAG, &debug, nil},
+        {'f', "file", "<file>", nil, MINIOPT_KIND_STRING, &file, nil},
+        {'l', "level", "<n>", nil, MINIOPT_KIND_INT, &level, nil},
+        {'c', nil, nil, nil, MINIOPT_KIND_CALLBACK, &callback, nil}};
+    const char *boundArgv[] = {"/path/to/myapp.exe", "-vvv", "--debug",
+                               "-f", "a.txt", "x", "--level=-7", "-cvc"};
+    miniopt_spec_init(&spec, bounds, 5, nil);
+    miniopt_ctx_init(&ctx1, &spec, 8, (char **)boundArgv);
+    if (miniopt_ctx_getopt(&ctx1) != MINIOPT_PASS ||
+        std::string(miniopt_ctx_optarg(&ctx1)) != "x" ||
+        miniopt_ctx_getopt(&ctx1) != MINIOPT_FINISHED || verbose != 4 ||
+        debug != 1 || std::string(file) != "a.txt" || level != -7 ||
+        callbackSum != 2) {
+        printf("error: bound options are wrong.\n");
+        return -1;
+    }
+    option badBound[] = {
+        {'v', nil, "<n>", nil, MINIOPT_KIND_COUNTER, &verbose, nil}};
+    if (miniopt_spec_init(&spec, badBound, 1, nil) == 0) {
+        printf("error: bound kind is not checked.\n");
+        return -1;
+    }
+    return 0;
+}
+
+// "--append" is required, "-o" requires "--list", "-a" and "-r" are
+// exclusive.
+int TestRule() {
+    option_spec spec;
+    option_context ctx1;
+    option ruled[] = {{'l', "list", nil, nil, MINIOPT_KIND_NONE, nil, nil},
+                      {'o', nil, "<n>", nil, MINIOPT_KIND_NONE, nil, nil},
+                      {'a', "append", nil, nil, MINIOPT_KIND_NONE, nil, nil},
+                      {'r', "remove", nil, nil, MINIOPT_KIND_NONE, nil, nil}};
+    const option_rule rules[] = {{MINIOPT_RULE_REQUIRED, 2, 2},
+                                 {MINIOPT_RULE_REQUIRES, 1, 0},
+                                 {MINIOPT_RULE_EXCLUSIVE, 2, 3}};
+    struct {
+        int argc;
+        const char *argv[4];
+        const char *what;
+    } ruleCases[] = {
+        {4, {"/path/to/myapp.exe", "-a", "-o", "1"},
+         "option -o requires option --list."},
+        {2, {"/path/to/myapp.exe", "-l"}, "option --append is required."},
+        {4, {"/path/to/myapp.exe", "-l", "-r", "--append"},
+         "option --append cannot be used with option --remove."}};
+    miniopt_spec_init(&spec, ruled, 4, nil);
+    if (miniopt_spec_rules(&spec, rules, 3) != 0) {
+        printf("error: %s\n", miniopt_spec_what(&spec));
+        return -1;
+    }
+    for (auto &c : ruleCases) {
+        miniopt_ctx_init(&ctx1, &spec, c.argc, (char **)c.argv);
+        while (miniopt_ctx_getopt(&ctx1) > 0) {}
+        if (miniopt_ctx_error(&ctx1)->code == MINIOPT_ERR_NONE ||
+            std::string(miniopt_ctx_what(&ctx1)) != c.what) {
+            printf("error: option rule is not checked: %s\n", c.what);
+            return -1;
+        }
+    }
+    const char *ruleArgv[] = {"/path/to/myapp.exe", "-o", "1", "-la"};
+    miniopt_ctx_init(&ctx1, &spec, 4, (char **)ruleArgv);
+    while (miniopt_ctx_getopt(&ctx1) > 0) {}
+    const option_rule badRule[] = {{MINIOPT_RULE_EXCLUSIVE, 2, 2}};
+    if (miniopt_ctx_error(&ctx1)->code != MINIOPT_ERR_NONE ||
+        miniopt_spec_rules(&spec, badRule, 1) == 0) {
+        printf("error: option rules are wrong.\n");
+        return -1;
+    }
+    // The rules of a big option array use the options after
+    // RULE_OPTION_MAX_SIZE, but not more than RULE_OPTION_MAX_SIZE options.
+    const int bigsum = RULE_OPTION_MAX_SIZE * 2 + 1;
+    static char bigNames[bigsum][8];
+    static option bigOpts[bigsum] = {};
+    static option_rule bigRules[RULE_OPTION_MAX_SIZE + 1];
+    for (int i = 0; i < bigsum; ++i) {
+        snprintf(bigNames[i], sizeof(bigNames[i]), "opt%d", i);
+        bigOpts[i].lname = bigNames[i];
+    }
+    const option_rule farRules[] = {
+        {MINIOPT_RULE_EXCLUSIVE, bigsum - 1, 1},
+        {MINIOPT_RULE_REQUIRES, bigsum - 1, RULE_OPTION_MAX_SIZE}};
+    const char *farArgv[] = {"/path/to/myapp.exe", "--opt1", "--opt128"};
+    const char *farWhat[] = {
+        "option --opt128 cannot be used with option --opt1.",
+        "option --opt128 requires option --opt64."};
+    miniopt_spec_init(&spec, bigOpts, bigsum, nil);
+    for (int i = 0; i < 2; ++i) {
+        if (miniopt_spec_rules(&spec, farRules, 2) != 0) {
+            printf("error: %s\n", miniopt_spec_what(&spec));
+            return -1;
+        }
+        miniopt_ctx_init(&ctx1, &spec, 3 - i, (char **)farArgv + i);
+        while (miniopt_ctx_getopt(&ctx1) > 0) {}
+        if (std::string(miniopt_ctx_what(&ctx1)) != farWhat[i]) {
+            printf("error: far option rule is wrong: %s\n",
+                   miniopt_ctx_what(&ctx1));
+            return -1;
+        }
+    }
+    for (int i = 0; i <= RULE_OPTION_MAX_SIZE; ++i) {
+        bigRules[i] = {MINIOPT_RULE_REQUIRED, i * 2, 0};
+    }
+    if (miniopt_spec_rules(&spec, bigRules, RULE_OPTION_MAX_SIZE + 1) == 0) {
+        printf("error: too many rule options are not rejected.\n");
+        return -1;
+    }
+    printf("%s\n", miniopt_spec_what(&spec));
+    return 0;
+}
+
+// Repeated "-a" and "-r" values are gathered into contiguous lists, from
+// argv and from a stream(the stream values are copied into the arena), then
+// from argv by a pool allocator, which gets the nodes back.
+int TestList() {
+    option_spec spec;
+    option_context ctx1;
+    option_list appends = {nil, 0};
+    option_list removes = {nil, 0};
+    option lists[] = {
+        {'a', "append", "<file>", nil, MINIOPT_KIND_LIST, &appends, nil},
+        {'r', "remove", "<file>", nil, MINIOPT_KIND_LIST, &removes, nil},
+        {'v', nil, nil, nil, MINIOPT_KIND_NONE, nil, nil}};
+    const char *listArgv[] = {"/path/to/myapp.exe", "-a", "key1", "-akey2",
+                              "-r", "1", "x", "--append=key3", "-v",
+                              "-r2"};
+    const char *listWant[] = {"key1", "key2", "key3", "1", "2"};
+    char arenaBuf[512];
+    option_arena arena;
+    option_pool pool;
+    static option_stream stream;
+    miniopt_spec_init(&spec, lists, 3, nil);
+    Input listInput;
+    for (int i = 1; i < 10; ++i) {
+        listInput.data += listArgv[i];
+        listInput.data += '\0';
+    }
+    miniopt_stream_init(&stream, ReadInput, &listInput);
+    for (int pass = 0; pass < 3; ++pass) {
+        miniopt_arena_init(&arena, arenaBuf, sizeof(arenaBuf));
+        if (pass == 1) {
+            miniopt_ctx_init_source(&ctx1, &spec, miniopt_stream_source,
+                                    &stream);
+        } else {
+            miniopt_ctx_init(&ctx1, &spec, 10, (char **)listArgv);
+        }
+        miniopt_ctx_setarena(&ctx1, &arena);
+        if (pass == 2) {
+            miniopt_pool_init(&pool, arenaBuf, 7 * 32, 32);
+            miniopt_ctx_setalloc(&ctx1, miniopt_pool_alloc_fn, &pool);
+        }
+        int got = 0;
+        int status1;
+        while ((status1 = miniopt_ctx_getopt(&ctx1)) > 0) ++got;
+        bool same = status1 == MINIOPT_FINISHED && got == 2 &&
+                    appends.size == 3 && removes.size == 2 &&
+                    (pass != 2 || miniopt_pool_alloc(&pool) != nil);
+        for (int i = 0; same && i < 5; ++i) {
+            const char *value =
+                i < 3 ? appends.items[i] : removes.items[i - 3];
+            same = std::string(value) == listWant[i];
+        }
+        if (!same) {
+            printf("error: list values are wrong.\n");
+            return -1;
+        }
+    }
+    miniopt_arena_init(&arena, arenaBuf, 40);
+    miniopt_ctx_init(&ctx1, &spec, 10, (char **)listArgv);
+    miniopt_ctx_setarena(&ctx1, &arena);
+    while (miniopt_ctx_getopt(&ctx1) > 0) {}
+    if (miniopt_ctx_error(&ctx1)->code != MINIOPT_ERR_NO_MEMORY) {
+        printf("error: full arena is not detected.\n");
+        return -1;
+    }
+    printf("%s\n", miniopt_ctx_what(&ctx1));
+    return 0;
+}
+
+// Env and config options, see TestEnv() and TestConfig().
+long long limit = 0;
+int envDebug = 0;
+option envs[] = {
+    {'l', "limit", "<n>", nil, MINIOPT_KIND_INT, &limit, "LIMIT"},
+    {'n', "name", "<name>", nil, MINIOPT_KIND_NONE, nil, "NAME"},
+    {nil, "debug", nil, nil, MINIOPT_KIND_FLAG, &envDebug, "DEBUG"},
+    {'q', nil, nil, nil, MINIOPT_KIND_NONE, nil, "QUIET"}};
+
+// "--limit" in argv overrides "MYAPP_LIMIT", "--name" and "--debug" are
+// filled from the env, "MYAPP_QUIET=0" is not delivered.
+int TestEnv() {
+    option_spec spec;
+    option_context ctx1;
+    char arenaBuf[512];
+    option_arena arena;
+    const char *envp[] = {"PATH=/bin",        "MYAPP_LIMIT=5",
+                          "MYAPP_NAME=env",   "MYAPP_DEBUG=1",
+                          "MYAPP_QUIET=0",    "LIMIT=9",
+                          "MYAPP_NAME=later", nil};
+    const char *envArgv[] = {"/path/to/myapp.exe", "--limit=3", "x"};
+    if (miniopt_spec_init(&spec, envs, 4, nil) != 0) {
+        printf("error: %s\n", miniopt_spec_what(&spec));
+        return -1;
+    }
+    miniopt_arena_init(&arena, arenaBuf, sizeof(arenaBuf));
+    miniopt_ctx_init(&ctx1, &spec, 3, (char **)envArgv);
+    miniopt_ctx_setarena(&ctx1, &arena);
+    if (miniopt_ctx_setenv(&ctx1, (char **)envp, "MYAPP_") != MINIOPT_PASS ||
+        miniopt_ctx_getopt(&ctx1) != MINIOPT_PASS ||
+        std::string(miniopt_ctx_optarg(&ctx1)) != "x" ||
+        miniopt_ctx_getopt(&ctx1) != MINIOPT_PASS ||
+        miniopt_ctx_optind(&ctx1) != 1 ||
+        std::string(miniopt_ctx_optarg(&ctx1)) != "env" ||
+        miniopt_ctx_getopt(&ctx1) != MINIOPT_FINISHED || limit != 3 ||
+        envDebug != 1) {
+        printf("error: env values are wrong.\n");
+        return -1;
+    }
+    option dupEnv[] = {{'a', nil, nil, nil, MINIOPT_KIND_NONE, nil, "A"},
+                       {'b', nil, nil, nil, MINIOPT_KIND_NONE, nil, "A"}};
+    if (miniopt_spec_init(&spec, dupEnv, 2, nil) == 0) {
+        printf("error: duplicate env name is not detected.\n");
+        return -1;
+    }
+    printf("%s\n", miniopt_spec_what(&spec));
+    return 0;
+}
+
+// "commit" is the first non-option arg, so the next options are from the
+// commit option array, "push" is not looked up as a subcommand.
+// Long name lookup of the "commit" options, "--message" is 0 and "--all"
+// is 1.
+int CommitLookup(const char *beg, const char *end) {
+    std::string name(beg, end);
+    return name == "message" ? 0 : name == "all" ? 1 : -1;
+}
+
+int TestSubcommand() {
+    option_spec spec;
+    option_spec subspec;
+    option_context ctx1;
+    option_arena arena;
+    const char *message = nil;
+    option top[] = {{'v', "verbose", nil, nil, MINIOPT_KIND_NONE, nil, nil}};
+    option commitOpts[] = {
+        {'m', "message", "<msg>", nil, MINIOPT_KIND_STRING, &message,
+         "MESSAGE"},
+        {'a', "all", nil, nil, MINIOPT_KIND_NONE, nil, nil}};
+    option pushOpts[] = {{'f', "force", nil, nil, MINIOPT_KIND_NONE, nil, nil}};
+    option_command commands[] = {{"commit", commitOpts, 2, CommitLookup},
+                                 {"push", pushOpts, 1, nil}};
+    const char *commandArgv[] = {"/path/to/myapp.exe", "-v", "commit",
+                                 "--message", "x", "push", "--all"};
+    const char *envArgv[] = {"/path/to/myapp.exe", "-v", "commit"};
+    const char *commandEnvp[] = {"MYAPP_MESSAGE=env", nil};
+    miniopt_spec_init(&spec, top, 1, nil);
+    if (miniopt_spec_commands(&spec, commands, 2) != 0) {
+        printf("error: %s\n", miniopt_spec_what(&spec));
+        return -1;
+    }
+    // Pass 0 uses the caller storage and the lookup, pass 1 the context
+    // allocator and the long name index.
+    static char specBuf[sizeof(option_spec) + 64];
+    for (int i = 0; i < 2; ++i) {
+        message = nil;
+        commands[0].lookup = i == 0 ? CommitLookup : nil;
+        miniopt_ctx_init(&ctx1, &spec, 7, (char **)commandArgv);
+        if (i == 0) {
+            miniopt_ctx_setsubspec(&ctx1, &subspec);
+        } else {
+            // The spec is not 32 bytes aligned in the arena after this.
+            miniopt_arena_init(&arena, specBuf, sizeof(specBuf));
+            miniopt_arena_alloc(&arena, 8);
+            miniopt_ctx_setarena(&ctx1, &arena);
+        }
+        if (miniopt_ctx_getopt(&ctx1) != MINIOPT_PASS ||
+            miniopt_ctx_optind(&ctx1) != 0 ||
+            miniopt_ctx_command(&ctx1) != -1 ||
+            miniopt_ctx_getopt(&ctx1) != MINIOPT_COMMAND ||
+            miniopt_ctx_command(&ctx1) != 0 ||
+            std::string(miniopt_ctx_optarg(&ctx1)) != "commit" ||
+            miniopt_ctx_getopt(&ctx1) != MINIOPT_PASS ||
+            miniopt_ctx_optind(&ctx1) != 2 ||
+            std::string(miniopt_ctx_optarg(&ctx1)) != "push" ||
+            miniopt_ctx_getopt(&ctx1) != MINIOPT_PASS ||
+            miniopt_ctx_optind(&ctx1) != 1 ||
+            miniopt_ctx_getopt(&ctx1) != MINIOPT_FINISHED ||
+            message == nil || std::string(message) != "x") {
+            printf("error: subcommand is wrong.\n");
+            return -1;
+        }
+        miniopt_ctx_release(&ctx1);
+    }
+    // The env is scanned again for the subcommand options.
+    message = nil;
+    miniopt_arena_init(&arena, specBuf, sizeof(specBuf));
+    miniopt_ctx_init(&ctx1, &spec, 3, (char **)envArgv);
+    miniopt_ctx_setarena(&ctx1, &arena);
+    miniopt_ctx_setenv(&ctx1, (char **)commandEnvp, "MYAPP_");
+    if (miniopt_ctx_getopt(&ctx1) != MINIOPT_PASS ||
+        miniopt_ctx_getopt(&ctx1) != MINIOPT_COMMAND ||
+        miniopt_ctx_getopt(&ctx1) != MINIOPT_FINISHED || message == nil ||
+        std::string(message) != "env") {
+        printf("error: subcommand env is wrong.\n");
+        return -1;
+    }
+    miniopt_ctx_release(&ctx1);
+    miniopt_ctx_init(&ctx1, &spec, 3, (char **)commandArgv + 3);
+    if (miniopt_ctx_getopt(&ctx1) != MINIOPT_PASS ||
+        std::string(miniopt_ctx_optarg(&ctx1)) != "x" ||
+        miniopt_ctx_getopt(&ctx1) != MINIOPT_PASS ||
+        miniopt_ctx_optind(&ctx1) != 1 ||
+        miniopt_ctx_getopt(&ctx1) != MINIOPT_FINISHED) {
+        printf("error: unknown subcommand is wrong.\n");
+        return -1;
+    }
+    miniopt_ctx_init(&ctx1, &spec, 3, (char **)commandArgv + 4);
+    miniopt_ctx_setalloc(&ctx1, nil, nil);
+    if (miniopt_ctx_getopt(&ctx1) != MINIOPT_ERROR ||
+        miniopt_ctx_error(&ctx1)->code != MINIOPT_ERR_NO_MEMORY) {
+        printf("error: subcommand without allocator is not detected.\n");
+        return -1;
+    }
+    printf("%s\n", miniopt_ctx_what(&ctx1));
+    // The singleton has its own subcommand spec, no allocator is needed.
+    message = nil;
+    miniopt.setcommands(commands, 2);
+    if (miniopt.init(7, (char **)commandArgv, top, 1) != 0 ||
+        miniopt.getopt() != MINIOPT_PASS ||
+        miniopt.getopt() != MINIOPT_COMMAND || miniopt.command() != 0 ||
+        miniopt.getopt() != MINIOPT_PASS ||
+        miniopt.getopt() != MINIOPT_PASS || miniopt.optind() != 1 ||
+        miniopt.getopt() != MINIOPT_FINISHED || message == nil ||
+        std::string(message) != "x") {
+        printf("error: miniopt subcommand is wrong: %s\n", miniopt.what());
+        return -1;
+    }
+    option_command dupCommands[] = {{"push", commitOpts, 2, nil},
+                                    {"push", pushOpts, 1, nil}};
+    if (miniopt_spec_commands(&spec, dupCommands, 2) == 0) {
+        printf("error: duplicate subcommand is not detected.\n");
+        return -1;
+    }
+    printf("%s\n", miniopt_spec_what(&spec));
+    return 0;
+}
+
+// The options checked by miniopt_static_check() skip the runtime checks.
+// Long name lookup of staticOpts.
+int StaticLookup(const char *beg, const char *end) {
+    std::string name(beg, end);
+    if (name == "verbose") return 0;
+    if (name == "out") return 1;
+    return name == "dry-run" ? 2 : -1;
+}
+
+int TestStaticCheck() {
+    option_spec spec;
+    option_spec tableSpec;
+    option_tables tables;
+    option_context ctx1;
+    char arenaBuf[256];
+    option_arena arena;
+    const char *staticArgv[] = {"/path/to/myapp.exe", "-vv", "--out", "x",
+                                "--dry-run"};
+    const char *staticEnvp[] = {"DRY_RUN=1", nil};
+    if (miniopt_spec_init_prevalidated(&spec, (option *)staticOpts, 3,
+                                       nil) != 0) {
+        printf("error: %s\n", miniopt_spec_what(&spec));
+        return -1;
+    }
+    // The tables of a built spec are used by the next init as they are.
+    miniopt_spec_tables(&spec, &tables);
+    if (miniopt_spec_init_tables(&tableSpec, (option *)staticOpts, 3,
+                                 StaticLookup, &tables) != 0) {
+        printf("error: %s\n", miniopt_spec_what(&tableSpec));
+        return -1;
+    }
+    for (int i = 0; i < 2; ++i) {
+        staticVerbose = 0;
+        miniopt_ctx_init(&ctx1, i == 0 ? &spec : &tableSpec, 5,
+                         (char **)staticArgv);
+        if (miniopt_ctx_getopt(&ctx1) != MINIOPT_PASS ||
+            miniopt_ctx_optind(&ctx1) != 1 ||
+            std::string(miniopt_ctx_optarg(&ctx1)) != "x" ||
+            miniopt_ctx_getopt(&ctx1) != MINIOPT_PASS ||
+            miniopt_ctx_optind(&ctx1) != 2 ||
+            miniopt_ctx_getopt(&ctx1) != MINIOPT_FINISHED ||
+            staticVerbose != 2) {
+            printf("error: prevalidated options are wrong.\n");
+            return -1;
+        }
+        miniopt_ctx_release(&ctx1);
+    }
+    miniopt_arena_init(&arena, arenaBuf, sizeof(arenaBuf));
+    miniopt_ctx_init(&ctx1, &tableSpec, 1, (char **)staticArgv);
+    miniopt_ctx_setarena(&ctx1, &arena);
+    if (miniopt_ctx_setenv(&ctx1, (char **)staticEnvp, nil) != MINIOPT_PASS ||
+        miniopt_ctx_getopt(&ctx1) != MINIOPT_PASS ||
+        miniopt_ctx_optind(&ctx1) != 2 ||
+        miniopt_ctx_getopt(&ctx1) != MINIOPT_FINISHED) {
+        printf("error: env of prebuilt tables is wrong.\n");
+        return -1;
+    }
+    miniopt_ctx_release(&ctx1);
+    miniopt_spec_release(&tableSpec);
+    miniopt_spec_release(&spec);
+    return 0;
+}
+
+// Long name lookup of settingOpts, "--alpha" is 0 and "--beta" is 1.
+int SettingLookup(const char *beg, const char *end) {
+    std::string name(beg, end);
+    return name == "alpha" ? 0 : name == "beta" ? 1 : -1;
+}
+
+// The settings of an init are not used by the next init, "--alpha" is 1 by
+// the default index and "-b" is not required any more.
+int TestInitTwice() {
+    option settingOpts[] = {
+        {'a', "alpha", nil, nil, MINIOPT_KIND_NONE, nil, nil},
+        {'b', "beta", nil, nil, MINIOPT_KIND_NONE, nil, nil}};
+    option otherOpts[] = {
+        {'g', "gamma", nil, nil, MINIOPT_KIND_NONE, nil, nil},
+        {'a', "alpha", nil, nil, MINIOPT_KIND_NONE, nil, nil}};
+    const option_rule rules[] = {{MINIOPT_RULE_REQUIRED, 1, 1}};
+    const char *settingArgv[] = {"/path/to/myapp.exe", "--alpha", "--beta"};
+    const char *otherArgv[] = {"/path/to/myapp.exe", "--gamma", "--alpha"};
+
+    miniopt.setlookup(SettingLookup);
+    miniopt.setrules(rules, 1);
+    if (miniopt.init(3, (char **)settingArgv, settingOpts, 2) != 0 ||
+        miniopt.getopt() != MINIOPT_PASS || miniopt.optind() != 0 ||
+        miniopt.getopt() != MINIOPT_PASS || miniopt.optind() != 1 ||
+        miniopt.getopt() != MINIOPT_FINISHED) {
+        printf("error: first init is wrong: %s\n", miniopt.what());
+        return -1;
+    }
+    if (miniopt.init(3, (char **)otherArgv, otherOpts, 2) != 0 ||
+        miniopt.getopt() != MINIOPT_PASS || miniopt.optind() != 0 ||
+        miniopt.getopt() != MINIOPT_PASS || miniopt.optind() != 1 ||
+        miniopt.getopt() != MINIOPT_FINISHED) {
+        printf("error: settings are used by the next init: %s\n",
+               miniopt.what());
+        return -1;
+    }
+    return 0;
+}
+
+// The long index is twice the long names(a power of 2), it is allocated if
+// it does not fit in the inline slots.
+int TestLongIndex() {
+    option_spec spec;
+    option_context ctx1;
+    option_arena arena;
+    static char arenaBuf[128 * 1024];
+    const int bigsum = LONG_INDEX_INLINE_SIZE / 2 + 1;
+    std::vector<std::string> names(bigsum);
+    std::vector<option> bigOpts;
+    for (int i = 0; i < bigsum; ++i) {
+        names[i] = "name-" + std::to_string(i);
+        bigOpts.push_back({nil, names[i].c_str(), nil, nil, MINIOPT_KIND_NONE,
+                           nil, nil});
+    }
+    if (miniopt_spec_init(&spec, options, optsum, nil) != 0 ||
+        spec.longMask + 1 != 16) {
+        printf("error: small long index is wrong.\n");
+        return -1;
+    }
+    if (miniopt_spec_init(&spec, bigOpts.data(), bigsum, nil) == 0) {
+        printf("error: long index without memory is not detected.\n");
+        return -1;
+    }
+    printf("%s\n", miniopt_spec_what(&spec));
+    std::string token = "--" + names[bigsum - 1];
+    const char *bigArgv[] = {"/path/to/myapp.exe", token.c_str()};
+    miniopt_arena_init(&arena, arenaBuf, sizeof(arenaBuf));
+    if (miniopt_spec_init_alloc(&spec, bigOpts.data(), bigsum, nil,
+                                miniopt_arena_alloc_fn, &arena) != 0 ||
+        spec.longMask + 1 != 2 * LONG_INDEX_INLINE_SIZE) {
+        printf("error: big long index is wrong.\n");
+        return -1;
+    }
+    miniopt_ctx_init(&ctx1, &spec, 2, (char **)bigArgv);
+    if (miniopt_ctx_getopt(&ctx1) != MINIOPT_PASS ||
+        miniopt_ctx_optind(&ctx1) != bigsum - 1) {
+        printf("error: big long index lookup is wrong.\n");
+        return -1;
+    }
+    miniopt_spec_release(&spec);
+    return 0;
+}
+
+#ifdef USING_MINIOPT_MMAP
+// The precedence is file < env < argv: "limit" is from the env, "name" is
+// from argv, "debug" is from the file.
+int TestConfig() {
+    option_spec spec;
+    option_context ctx1;
+    char arenaBuf[512];
+    option_arena arena;
+    const char *configPath = "miniopt_test.conf";
+    const char *configs[] = {"# comment\n\nlimit = 9\r\n name=\"from file\"\n"
+                             "debug = yes",
+                             "limit = 1\nlimt = 2\n",
+                             "limit = 1\nlimit 2\n"};
+    const char *configWhat[] = {
+        "",
+        "miniopt_test.conf:2: option limt is unknown. Did you mean --limit?",
+        "miniopt_test.conf:2: line is not \"key = value\"."};
+    const char *configEnvp[] = {"MYAPP_LIMIT=5", nil};
+    const char *configArgv[] = {"/path/to/myapp.exe", "--name=argv", "x"};
+    miniopt_spec_init(&spec, envs, 4, nil);
+    for (int i = 0; i < 3; ++i) {
+        FILE *file = fopen(configPath, "wb");
+        if (file == nil) {
+            printf("error: cannot write %s.\n", configPath);
+            return -1;
+        }
+        fputs(configs[i], file);
+        fclose(file);
+
+        limit = 0;
+        envDebug = 0;
+        miniopt_arena_init(&arena, arenaBuf, sizeof(arenaBuf));
+        miniopt_ctx_init(&ctx1, &spec, 3, (char **)configArgv);
+        miniopt_ctx_setarena(&ctx1, &arena);
+        int status1 = miniopt_ctx_setconfig(&ctx1, configPath);
+        if (i > 0) {
+            if (status1 != MINIOPT_ERROR ||
+                std::string(miniopt_ctx_what(&ctx1)) != configWhat[i]) {
+                printf("error: config error is wrong.\n");
+                return -1;
+            }
+            printf("%s\n", miniopt_ctx_what(&ctx1));
+        } else if (
+            status1 != MINIOPT_PASS ||
+            miniopt_ctx_setenv(&ctx1, (char **)configEnvp, "MYAPP_") !=
+                MINIOPT_PASS ||
+            miniopt_ctx_getopt(&ctx1) != MINIOPT_PASS ||
+            std::string(miniopt_ctx_optarg(&ctx1)) != "argv" ||
+            miniopt_ctx_getopt(&ctx1) != MINIOPT_PASS ||
+            std::string(miniopt_ctx_optarg(&ctx1)) != "x" ||
+            miniopt_ctx_getopt(&ctx1) != MINIOPT_FINISHED || limit != 5 ||
+            envDebug != 1) {
+            printf("error: config values are wrong.\n");
+            return -1;
+        }
+        miniopt_ctx_release(&ctx1);
+    }
+
+    // A "[name]" section fills the options of the invoked subcommand only.
+    const char *message = nil;
+    option commitOpts[] = {{'m', "message", "<msg>", nil, MINIOPT_KIND_STRING,
+                            &message, nil}};
+    option_command commands[] = {{"push", commitOpts, 1, nil},
+                                 {"commit", commitOpts, 1, nil}};
+    const char *sectionArgv[] = {"/path/to/myapp.exe", "commit"};
+    FILE *file = fopen(configPath, "wb");
+    if (file == nil) {
+        printf("error: cannot write %s.\n", configPath);
+        return -1;
+    }
+    fputs("limit = 9\n[push]\nforce = 1\n[commit]\nmessage = \"file\"\n"
+          "[other]\nmessage = other\n",
+          file);
+    fclose(file);
+    limit = 0;
+    miniopt_spec_commands(&spec, commands, 2);
+    static char specBuf[sizeof(option_spec) + 512];
+    miniopt_arena_init(&arena, specBuf, sizeof(specBuf));
+    miniopt_ctx_init(&ctx1, &spec, 2, (char **)sectionArgv);
+    miniopt_ctx_setarena(&ctx1, &arena);
+    if (miniopt_ctx_setconfig(&ctx1, configPath) != MINIOPT_PASS ||
+        miniopt_ctx_getopt(&ctx1) != MINIOPT_COMMAND ||
+        miniopt_ctx_getopt(&ctx1) != MINIOPT_FINISHED || limit != 9 ||
+        message == nil || std::string(message) != "file") {
+        printf("error: config section is wrong: %s\n", miniopt_ctx_what(&ctx1));
+        return -1;
+    }
+    miniopt_ctx_release(&ctx1);
+    remove(configPath);
+    return 0;
+}
+#endif
+
+#ifdef USING_MINIOPT_ABBREV
+// "--app" is "--append", "--re" is ambiguous("--remove", "--reset").
+// A lookup finds nothing, the long names are resolved by the trie.
+int NoLookup(const char *, const char *) {
+    return -1;
+}
+
+int TestAbbreviation() {
+    option_spec spec;
+    option_context ctx1;
+    option abbrevs[] = {
+        {'a', "append", "<file>", nil, MINIOPT_KIND_NONE, nil, nil},
+        {'r', "remove", "<file>", nil, MINIOPT_KIND_NONE, nil, nil},
+        {nil, "reset", nil, nil, MINIOPT_KIND_NONE, nil, nil}};
+    const char *abbrevArgv[] = {"/path/to/myapp.exe", "--app=x", "--rem",
+                                "y", "--res", "--re"};
+    miniopt_spec_init(&spec, abbrevs, 3, nil);
+    miniopt_ctx_init(&ctx1, &spec, 6, (char **)abbrevArgv);
+    const int abbrevOptinds[] = {0, 1, 2};
+    for (int i = 0; i < 3; ++i) {
+        if (miniopt_ctx_getopt(&ctx1) != MINIOPT_PASS ||
+            miniopt_ctx_optind(&ctx1) != abbrevOptinds[i]) {
+            printf("error: abbreviation is not resolved.\n");
+            return -1;
+        }
+    }
+    if (miniopt_ctx_getopt(&ctx1) != MINIOPT_ERROR ||
+        miniopt_ctx_error(&ctx1)->code != MINIOPT_ERR_AMBIGUOUS_OPTION) {
+        printf("error: ambiguous abbreviation is not detected.\n");
+        return -1;
+    }
+    printf("%s\n", miniopt_ctx_what(&ctx1));
+
+    // A whole long name wins, a prefix of both is ambiguous.
+    option prefixes[] = {
+        {nil, "color", nil, nil, MINIOPT_KIND_NONE, nil, nil},
+        {nil, "colors", nil, nil, MINIOPT_KIND_NONE, nil, nil},
+        {nil, "debug", nil, nil, MINIOPT_KIND_NONE, nil, nil},
+        {nil, "debug-level", "<n>", nil, MINIOPT_KIND_NONE, nil, nil}};
+    const char *prefixArgv[] = {"/path/to/myapp.exe", "--color", "--colors",
+                                "--debug", "--debug-l=2", "--colo"};
+    if (miniopt_spec_init(&spec, prefixes, 4, nil) != 0) {
+        printf("error: %s\n", miniopt_spec_what(&spec));
+        return -1;
+    }
+    miniopt_ctx_init(&ctx1, &spec, 6, (char **)prefixArgv);
+    for (int i = 0; i < 4; ++i) {
+        if (miniopt_ctx_getopt(&ctx1) != MINIOPT_PASS ||
+            miniopt_ctx_optind(&ctx1) != i) {
+            printf("error: long name prefix is not resolved.\n");
+            return -1;
+        }
+    }
+    if (miniopt_ctx_getopt(&ctx1) != MINIOPT_ERROR ||
+        miniopt_ctx_error(&ctx1)->code != MINIOPT_ERR_AMBIGUOUS_OPTION) {
+        printf("error: ambiguous prefix is not detected.\n");
+        return -1;
+    }
+    printf("%s\n", miniopt_ctx_what(&ctx1));
+
+    // The trie finds a whole long name when the lookup does not.
+    miniopt_spec_init_prevalidated(&spec, prefixes, 4, NoLookup);
+    miniopt_ctx_init(&ctx1, &spec, 2, (char **)prefixArgv);
+    if (miniopt_ctx_getopt(&ctx1) != MINIOPT_PASS ||
+        miniopt_ctx_optind(&ctx1) != 0) {
+        printf("error: whole long name does not win.\n");
+        return -1;
+    }
+    return 0;
+}
+#endif
+
+int main() {
+    const struct {
+        const char *name;
+        int (*run)();
+    } tests[] = {{"", TestMiniopt},
+                 {"reentrant ", TestReentrant},
+                 {"parseall ", TestParseall},
+                 {"stream ", TestStream},
+                 {"duplicate ", TestDuplicate},
+                 {"error ", TestError},
+                 {"render ", TestRender},
+                 {"typed argument ", TestTypedArgument},
+                 {"bound ", TestBound},
+                 {"rule ", TestRule},
+                 {"list ", TestList},
+                 {"env ", TestEnv},
+                 {"subcommand ", TestSubcommand},
+                 {"static check ", TestStaticCheck},
+                 {"init twice ", TestInitTwice},
+                 {"long index ", TestLongIndex},
+#ifdef USING_MINIOPT_MMAP
+                 {"config ", TestConfig},
+#endif
+#ifdef USING_MINIOPT_ABBREV
+                 {"abbreviation ", TestAbbreviation},
+#endif
+    };
+
+    // Every test runs, so a failure names the feature broke.
+    int failed = 0;
+    for (auto &test : tests) {
+        if (test.run() == 0) {
+            printf("\n--%stest pass--\n", test.name);
+        } else {
+            printf("\n--%stest fail--\n", test.name);
+            ++failed;
+        }
+    }
+
+    return failed == 0 ? 0 : -1;
 }
\ No newline at end of file
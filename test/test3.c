@@ -7,79 +7,164 @@
  * file that was distributed with this source code.
  */
 
+// Generated by miniopt version 0.1.0 Sun Jul 31 16:23:16 2022
+
 #include "miniopt.h"
 #include <stdio.h>
 
-int ParseArgs(int argc, char **argv) {
+// Long name perfect hash, it must be the same as the code generator's.
+static unsigned int LongNameHash(const char *beg, const char *end,
+                                 unsigned int seed) {
+    unsigned int h = 2166136261u ^ seed;
+    while (beg < end) {
+        h ^= (unsigned char)*beg++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Long name lookup, it returns an index to options[] or -1.
+static int LongNameLookup(const char *beg, const char *end) {
+    static const int seeds[] = {
+        -1, 1, -2, -3, -4, 0, -6
+    };
+    static const int indexes[] = {
+        0, 3, 5, 2, 4, 6, 1
+    };
+    static const char *const names[] = {
+        "append", "modify", "offset", "query", "list", "limit", "remove"
+    };
+    const unsigned int sum = sizeof(indexes) / sizeof(indexes[0]);
+
+    int seed = seeds[LongNameHash(beg, end, 0) % sum];
+    unsigned int slot;
+    if (seed < 0) {
+        slot = (unsigned int)(-seed - 1);
+    } else {
+        slot = LongNameHash(beg, end, (unsigned int)seed) % sum;
+    }
+    const char *name = names[slot];
+    while (beg < end && *beg == *name) {
+        ++beg;
+        ++name;
+    }
+    return (beg == end && *name == '\0') ? indexes[slot] : -1;
+}
+
+// Pre-rendered help text, it is the same as miniopt.printopts(printf, 2).
+static const char HelpText[] =
+    "  -a --append <key=value>   append key and value.\n"
+    "  -r --remove <key>         remove key.\n"
+    "  -q --query <key>          query key.\n"
+    "  -m --modify <key=value>   modify key.\n"
+    "  -l --list                 list keys.\n"
+    "     --offset <n>           list offset number.\n"
+    "     --limit <n>            list size.\n"
+    "  -d  <val>                 define something.\n"
+    "  -e  <val>                 any description1.\n"
+    "  -f  <val>                 any description2.\n"
+    "  -g                        any description3.\n";
+
+// Prebuilt name indexes of the options, see miniopt.settables().
+static const int ShortIndex[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, 0, -1, -1, 7, 8, 9, 10, -1, -1, -1, -1, 4, 3, -1, -1,
+    -1, 2, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+static const unsigned char ShortHasArg[32] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 114, 32, 6, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+static const option_tables Tables = {ShortIndex, ShortHasArg, nil, 0, 1,
+    {2, 8, 12, 26}};
+
+// Memory of the list option values, a value takes about 32 bytes of it.
+static char ArgsMemory[64 * 1024];
+
+// Parsed options, an option not given is 0 or empty. An option without
+// argument counts how many times it is given, an option with argument gathers
+// all its values in argv order.
+typedef struct Args_ {
+    option_list append; // -a --append <key=value>
+    option_list remove; // -r --remove <key>
+    option_list query;  // -q --query <key>
+    option_list modify; // -m --modify <key=value>
+    int list;           // -l --list
+    option_list offset; //    --offset <n>
+    option_list limit;  //    --limit <n>
+    option_list d;      // -d <val>
+    option_list e;      // -e <val>
+    option_list f;      // -f <val>
+    int g;              // -g
+} Args;
+
+int ParseArgs(int argc, char *argv[], Args *args) {
     option options[] = {
-        {'a', "append", "<key=value>", "append key and value."},
-        {'r', "remove", "<key>", "remove key."},
-        {'q', "query", "<key>", "query key."},
-        {'m', "modify", "<key=value>", "modify key."},
-        {'l', "list", nil, "list keys."},
-        {nil, "offset", "<n>", "list offset number."},
-        {nil, "limit", "<n>", "list size."},
-        {'d', nil, "<val>", "define something."},
-        {'e', nil, "<val>", "any description1."},
-        {'f', nil, "<val>", "any description2."},
-        {'g', nil, nil, "any description3."}
+        {'a', "append", "<key=value>", "append key and value.",
+         MINIOPT_KIND_LIST, &args->append, nil},
+        {'r', "remove", "<key>", "remove key.",
+         MINIOPT_KIND_LIST, &args->remove, nil},
+        {'q', "query", "<key>", "query key.",
+         MINIOPT_KIND_LIST, &args->query, nil},
+        {'m', "modify", "<key=value>", "modify key.",
+         MINIOPT_KIND_LIST, &args->modify, nil},
+        {'l', "list", nil, "list keys.",
+         MINIOPT_KIND_COUNTER, &args->list, nil},
+        {nil, "offset", "<n>", "list offset number.",
+         MINIOPT_KIND_LIST, &args->offset, nil},
+        {nil, "limit", "<n>", "list size.",
+         MINIOPT_KIND_LIST, &args->limit, nil},
+        {'d', nil, "<val>", "define something.",
+         MINIOPT_KIND_LIST, &args->d, nil},
+        {'e', nil, "<val>", "any description1.",
+         MINIOPT_KIND_LIST, &args->e, nil},
+        {'f', nil, "<val>", "any description2.",
+         MINIOPT_KIND_LIST, &args->f, nil},
+        {'g', nil, nil, "any description3.",
+         MINIOPT_KIND_COUNTER, &args->g, nil}
     };
     const int optsum = sizeof(options) / sizeof(options[0]);
 
+    // The options are checked and indexed by the code generator, the list
+    // values are got from an arena.
+    static option_arena arena;
+    miniopt_arena_init(&arena, ArgsMemory, sizeof(ArgsMemory));
+    miniopt.setalloc(miniopt_arena_alloc_fn, &arena);
+    miniopt.setlookup(LongNameLookup);
+    miniopt.settables(&Tables);
     if (miniopt.init(argc, (char **)argv, options, optsum) != 0) {
         printf("error: %s\n", miniopt.what());
         return 0;
     }
 
+    // Options are stored into args, only non-option-arguments are returned.
     int status;
     while ((status = miniopt.getopt()) > 0) {
-        int id = miniopt.optind();
-        switch (id) {
-            case 0: // -a --append <key=value>
-                // <key=value> = miniopt.optarg()
-            break;
-            case 1: // -r --remove <key>
-                // <key> = miniopt.optarg()
-            break;
-            case 2: // -q --query <key>
-                // <key> = miniopt.optarg()
-            break;
-            case 3: // -m --modify <key=value>
-                // <key=value> = miniopt.optarg()
-            break;
-            case 4: // -l --list
-            break;
-            case 5: //    --offset <n>
-                // <n> = miniopt.optarg()
-            break;
-            case 6: //    --limit <n>
-                // <n> = miniopt.optarg()
-            break;
-            case 7: // -d <val>
-                // <val> = miniopt.optarg()
-            break;
-            case 8: // -e <val>
-                // <val> = miniopt.optarg()
-            break;
-            case 9: // -f <val>
-                // <val> = miniopt.optarg()
-            break;
-            case 10: // -g
-            break;
-            default:
-            printf("[non-opt-arg] arg = [%s]\n", miniopt.optarg());
-            break;
-        }
+        printf("[non-opt-arg] arg = [%s]\n", miniopt.optarg());
     }
 
     if (status < 0) printf("error: %s\n", miniopt.what());
 
     printf("\nOptions:\n");
-    miniopt.printopts(printf, 2);
+    fwrite(HelpText, 1, sizeof(HelpText) - 1, stdout);
 
     return status;
 }
 
 int main(int argc, char* argv[]){
-    return ParseArgs(argc, argv);
+    Args args = {0};
+    return ParseArgs(argc, argv, &args);
 }
@@ -22,7 +22,11 @@
 #include <regex>
 #include <vector>
 #include <ctime>
-#include <set>
+#include <unordered_set>
+#include <cstdint>
+#include <algorithm>
+#include <cctype>
+#include <memory>
 
 /**
  * @brief Option info.
@@ -249,6 +253,9 @@ Result GetNextItem(std::ifstream &ifs, bool useIfs, OptInfo &OptInfo,
 /**
  * @brief Do some check to the optInfoArray.
  * 
+ * The library option checks are done here too, so the generated code can
+ * skip them at init, see miniopt.setprevalidated().
+ * 
  * @param[in] optInfoArray  OptInfoArray to be checked.
  * 
  * @return 0        Pass.
@@ -257,21 +264,19 @@ Result GetNextItem(std::ifstream &ifs, bool useIfs, OptInfo &OptInfo,
 int ValidateOptInfoArray(const OptInfoArray &optInfoArray){
     if(optInfoArray.empty()) return -1;
 
-    std::set<std::string> tokenSet;
+    // One pass, names are hashed once each.
+    std::unordered_set<std::string> shortNameSet;
+    std::unordered_set<std::string> longNameSet;
     for(auto& opt: optInfoArray){
         if(!opt.shortName.empty()){
-            if(!tokenSet.insert(opt.shortName).second){
+            if(!shortNameSet.insert(opt.shortName).second){
                 printf("error: option short name = [%s] is duplicate.\n", 
                        opt.shortName.c_str());
                 return -1;
             }
         }
-    }
-
-    tokenSet.clear();
-    for(auto& opt: optInfoArray){
         if(!opt.longName.empty()){
-            if(!tokenSet.insert(opt.longName).second){
+            if(!longNameSet.insert(opt.longName).second){
                 printf("error: option long name = [%s] is duplicate.\n", 
                         opt.longName.c_str());
                 return -1;
@@ -279,6 +284,22 @@ int ValidateOptInfoArray(const OptInfoArray &optInfoArray){
         }
     }
 
+    std::vector<option> options;
+    for (auto &opt : optInfoArray) {
+        options.push_back(
+            {opt.shortName.empty() ? '\0' : opt.shortName[0],
+             opt.longName.empty() ? nil : opt.longName.c_str(),
+             opt.argHint.empty() ? nil : opt.argHint.c_str(), nil,
+             MINIOPT_KIND_NONE, nil, nil});
+    }
+    std::unique_ptr<option_spec> spec(new option_spec);
+    if (miniopt_spec_init(spec.get(), options.data(),
+                          static_cast<int>(options.size()), nil) != 0) {
+        printf("error: %s\n", miniopt_spec_what(spec.get()));
+        return -1;
+    }
+    miniopt_spec_release(spec.get());
+
     return 0;
 }
 
@@ -328,6 +349,93 @@ int FileToOptInfoArray(const std::string in, OptInfoArray &optInfoArray) {
     return ValidateOptInfoArray(optInfoArray);
 }
 
+/**
+ * @brief Hash a string(FNV-1a) with a seed.
+ * 
+ * It must be the same as the generated LongNameHash().
+ * 
+ * @param[in] str   Input string.
+ * @param[in] seed  Hash seed.
+ * 
+ * @return uint32_t Hash value.
+ */
+uint32_t HashWithSeed(const std::string &str, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    for (auto c : str) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/**
+ * @brief Build a minimal perfect hash(hash and displace) over the names.
+ * 
+ * A name is put into bucket HashWithSeed(name, 0) % n, then every bucket
+ * has more than one name searches a seed to move all its names into free
+ * slots by HashWithSeed(name, seed) % n. A bucket has only one name takes
+ * a free slot directly, it is stored as (-slot - 1).
+ * 
+ * @param[in] names     Input names, they should be unique.
+ * @param[out] seeds    Output seed of each bucket.
+ * @param[out] slots    Output name index of each slot.
+ * 
+ * @return 0            Pass.
+ * @return other        Fail.
+ */
+int BuildPerfectHash(const std::vector<std::string> &names,
+                     std::vector<int> &seeds, std::vector<int> &slots) {
+    const uint32_t n = static_cast<uint32_t>(names.size());
+    seeds.assign(n, 0);
+    slots.assign(n, -1);
+    if (n == 0) return 0;
+
+    std::vector<std::vector<int>> buckets(n);
+    for (uint32_t i = 0; i < n; ++i) {
+        buckets[HashWithSeed(names[i], 0) % n].push_back(i);
+    }
+
+    std::vector<uint32_t> order(n);
+    for (uint32_t i = 0; i < n; ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t lhs, uint32_t rhs) {
+        return buckets[lhs].size() > buckets[rhs].size();
+    });
+
+    std::size_t k = 0;
+    for (; k < order.size() && buckets[order[k]].size() > 1; ++k) {
+        const auto &bucket = buckets[order[k]];
+        std::vector<uint32_t> used;
+        uint32_t seed = 1;
+        for (; seed < 0x7fffffffu; ++seed) {
+            used.clear();
+            for (auto i : bucket) {
+                uint32_t slot = HashWithSeed(names[i], seed) % n;
+                if (slots[slot] >= 0 ||
+                    std::find(used.begin(), used.end(), slot) != used.end()) {
+                    break;
+                }
+                used.push_back(slot);
+            }
+            if (used.size() == bucket.size()) break;
+        }
+        if (used.size() != bucket.size()) return -1;
+
+        seeds[order[k]] = static_cast<int>(seed);
+        for (std::size_t j = 0; j < bucket.size(); ++j) {
+            slots[used[j]] = bucket[j];
+        }
+    }
+
+    uint32_t freeSlot = 0;
+    for (; k < order.size() && buckets[order[k]].size() == 1; ++k) {
+        while (slots[freeSlot] >= 0) ++freeSlot;
+        slots[freeSlot] = buckets[order[k]].front();
+        seeds[order[k]] = -static_cast<int>(freeSlot) - 1;
+    }
+
+    return 0;
+}
+
 /**
  * @brief Convert OptInfoArray to stream.
  * 
@@ -397,6 +505,63 @@ int OptInfoArrayToCode(const OptInfoArray &OptInfoArray,
         return str;
     };
 
+    // Args field name of each option, it is a valid and unique C identifier.
+    auto genFieldNames = [&]() {
+        static const std::unordered_set<std::string> keywords = {
+            "auto", "bool", "break", "case", "char", "class", "const",
+            "continue", "default", "delete", "do", "double", "else", "enum",
+            "extern", "false", "float", "for", "goto", "if", "inline", "int",
+            "long", "new", "operator", "private", "protected", "public",
+            "register", "restrict", "return", "short", "signed", "sizeof",
+            "static", "struct", "switch", "template", "this", "true",
+            "typedef", "union", "unsigned", "using", "virtual", "void",
+            "volatile", "while"};
+        std::vector<std::string> fields;
+        std::unordered_set<std::string> used;
+        for (auto &opt : OptInfoArray) {
+            std::string name =
+                opt.longName.empty() ? opt.shortName : opt.longName;
+            for (auto &c : name) {
+                if (!std::isalnum(static_cast<unsigned char>(c))) c = '_';
+            }
+            if (std::isdigit(static_cast<unsigned char>(name[0])) ||
+                name == "_") {
+                name = "opt_" + name;
+            }
+            if (keywords.count(name)) name += "_";
+
+            std::string field = name;
+            for (int i = 2; !used.insert(field).second; ++i) {
+                field = name + "_" + std::to_string(i);
+            }
+            fields.push_back(field);
+        }
+        return fields;
+    };
+    const auto fieldNames = genFieldNames();
+
+    auto genArgList = [&]() {
+        std::vector<std::string> decls;
+        std::size_t width = 0;
+        for (std::size_t i = 0; i < OptInfoArray.size(); ++i) {
+            std::string decl = OptInfoArray[i].argHint.empty()
+                                   ? "int "
+                                   : "option_list ";
+            decls.push_back(decl + fieldNames[i] + ";");
+            width = std::max(width, decls.back().size());
+        }
+
+        std::string argList;
+        for (std::size_t i = 0; i < OptInfoArray.size(); ++i) {
+            argList += std::string(config::code::ArgListIndention, ' ');
+            argList += decls[i];
+            argList += std::string(width + 1 - decls[i].size(), ' ');
+            argList += cmt(OptInfoArray[i]);
+            if (i + 1 != OptInfoArray.size()) argList += "\n";
+        }
+        return argList;
+    };
+
     auto genOptionList = [&]() {
         std::string optionList;
         std::string opt;
@@ -421,43 +586,207 @@ int OptInfoArrayToCode(const OptInfoArray &OptInfoArray,
                     opt += "\"";
                 }
             }
-            opt += "}";
+            // Options are bound to the Args fields.
+            opt += ",\n";
+            opt += std::string(config::code::OptionListIndention + 1, ' ');
+            opt += it->argHint.empty() ? "MINIOPT_KIND_COUNTER, "
+                                       : "MINIOPT_KIND_LIST, ";
+            opt += "&args->" + fieldNames[it - OptInfoArray.begin()];
+            opt += ", nil}";
             if (it + 1 != OptInfoArray.end()) opt += ",\n";
             optionList += opt;
         }
         return optionList;
     };
 
-    auto genCaseList = [&]() {
-        std::string caseList;
-        std::string item;
-        int i = 0;
-        for (auto it = OptInfoArray.begin(); it != OptInfoArray.end();
-             ++it) {
-            item = std::string(config::code::CaseListIndention, ' ');
-            item += "case ";
-            item += std::to_string(i++) + ": " + cmt(*it) + "\n";
-
-            if(!it->argHint.empty()){
-                item += std::string(config::code::CaseListIndention, ' ');
-                item += "    // " + it->argHint + " = " + "miniopt.optarg()";
-                item += "\n";
+    auto genLongNameLookup = [&]() {
+        std::vector<std::string> names;
+        std::vector<int> optinds;
+        for (std::size_t i = 0; i < OptInfoArray.size(); ++i) {
+            if (!OptInfoArray[i].longName.empty()) {
+                names.push_back(OptInfoArray[i].longName);
+                optinds.push_back(static_cast<int>(i));
             }
+        }
+
+        std::string code;
+        code += "// Long name perfect hash, it must be the same as the code "
+                "generator's.\n";
+        code += "static unsigned int LongNameHash(const char *beg, "
+                "const char *end,\n";
+        code += "                                 unsigned int seed) {\n";
+        code += "    unsigned int h = 2166136261u ^ seed;\n";
+        code += "    while (beg < end) {\n";
+        code += "        h ^= (unsigned char)*beg++;\n";
+        code += "        h *= 16777619u;\n";
+        code += "    }\n";
+        code += "    return h;\n";
+        code += "}\n\n";
+        code += "// Long name lookup, it returns an index to options[] "
+                "or -1.\n";
+        code += "static int LongNameLookup(const char *beg, "
+                "const char *end) {\n";
+
+        std::vector<int> seeds;
+        std::vector<int> slots;
+        if (names.empty() || BuildPerfectHash(names, seeds, slots) != 0) {
+            code += "    (void)beg;\n";
+            code += "    (void)end;\n";
+            code += "    return -1;\n";
+            code += "}";
+            return code;
+        }
+
+        auto genArray = [](const std::string &decl,
+                           const std::vector<std::string> &items) {
+            std::string str = "    static const " + decl + "[] = {";
+            for (std::size_t i = 0; i < items.size(); ++i) {
+                str += (i % 8 == 0) ? "\n        " : " ";
+                str += items[i];
+                if (i + 1 != items.size()) str += ",";
+            }
+            str += "\n    };\n";
+            return str;
+        };
+
+        std::vector<std::string> seedItems;
+        std::vector<std::string> indexItems;
+        std::vector<std::string> nameItems;
+        for (auto seed : seeds) seedItems.push_back(std::to_string(seed));
+        for (auto slot : slots) {
+            indexItems.push_back(std::to_string(optinds[slot]));
+            nameItems.push_back("\"" + names[slot] + "\"");
+        }
+
+        code += genArray("int seeds", seedItems);
+        code += genArray("int indexes", indexItems);
+        code += genArray("char *const names", nameItems);
+        code += "    const unsigned int sum = sizeof(indexes) / "
+                "sizeof(indexes[0]);\n\n";
+        code += "    int seed = seeds[LongNameHash(beg, end, 0) % sum];\n";
+        code += "    unsigned int slot;\n";
+        code += "    if (seed < 0) {\n";
+        code += "        slot = (unsigned int)(-seed - 1);\n";
+        code += "    } else {\n";
+        code += "        slot = LongNameHash(beg, end, (unsigned int)seed) "
+                "% sum;\n";
+        code += "    }\n";
+        code += "    const char *name = names[slot];\n";
+        code += "    while (beg < end && *beg == *name) {\n";
+        code += "        ++beg;\n";
+        code += "        ++name;\n";
+        code += "    }\n";
+        code += "    return (beg == end && *name == '\\0') ? indexes[slot] "
+                ": -1;\n";
+        code += "}";
+        return code;
+    };
 
-            item += std::string(config::code::CaseListIndention, ' ');
-            item += "break;";
-            if(it + 1 != OptInfoArray.end()){
-                item += "\n";
+    auto genHelpText = [&]() {
+        // Render by the library, so it is the same as miniopt.printopts().
+        std::vector<std::string> descs;
+        for (auto &opt : OptInfoArray) {
+            std::string desc;
+            for (auto it = opt.descList.begin(); it != opt.descList.end();
+                 ++it) {
+                desc += *it;
+                if (it + 1 != opt.descList.end()) desc += "<br>";
             }
-            caseList += item;
+            descs.push_back(desc);
         }
-        return caseList;
+        std::vector<option> options;
+        for (std::size_t i = 0; i < OptInfoArray.size(); ++i) {
+            auto &opt = OptInfoArray[i];
+            options.push_back(
+                {opt.shortName.empty() ? '\0' : opt.shortName[0],
+                 opt.longName.empty() ? nil : opt.longName.c_str(),
+                 opt.argHint.empty() ? nil : opt.argHint.c_str(),
+                 descs[i].c_str(), MINIOPT_KIND_NONE, nil, nil});
+        }
+
+        std::unique_ptr<option_spec> spec(new option_spec);
+        miniopt_spec_init(spec.get(), options.data(),
+                          static_cast<int>(options.size()), nil);
+        std::string text(miniopt_spec_render(spec.get(),
+                                              config::code::HelpIndention,
+                                              nullptr, 0),
+                         '\0');
+        miniopt_spec_render(spec.get(), config::code::HelpIndention, &text[0],
+                            static_cast<int>(text.size()) + 1);
+        miniopt_spec_release(spec.get());
+
+        // The option texts are C string literal already, see genOptionList.
+        std::string code = "// Pre-rendered help text, it is the same as "
+                           "miniopt.printopts(printf, " +
+                           std::to_string(config::code::HelpIndention) +
+                           ").\nstatic const char HelpText[] =";
+        std::size_t beg = 0;
+        std::size_t end;
+        while ((end = text.find('\n', beg)) != std::string::npos) {
+            code += "\n    \"" + text.substr(beg, end - beg) + "\\n\"";
+            beg = end + 1;
+        }
+        code += ";";
+        return code;
+    };
+
+    auto genTables = [&]() {
+        // Indexed by the library, so they are the same as init builds.
+        std::vector<option> options;
+        for (auto &opt : OptInfoArray) {
+            options.push_back(
+                {opt.shortName.empty() ? '\0' : opt.shortName[0],
+                 opt.longName.empty() ? nil : opt.longName.c_str(),
+                 opt.argHint.empty() ? nil : opt.argHint.c_str(), nil,
+                 opt.argHint.empty() ? MINIOPT_KIND_COUNTER
+                                     : MINIOPT_KIND_LIST,
+                 nil, nil});
+        }
+        std::unique_ptr<option_spec> spec(new option_spec);
+        miniopt_spec_init_prevalidated(spec.get(), options.data(),
+                                       static_cast<int>(options.size()),
+                                       nil);
+        option_tables tables;
+        miniopt_spec_tables(spec.get(), &tables);
+
+        auto genArray = [](const std::string &decl, const int *items,
+                           int size) {
+            std::string str = "static const " + decl + "[" +
+                              std::to_string(size) + "] = {";
+            for (int i = 0; i < size; ++i) {
+                str += (i % 16 == 0) ? "\n    " : " ";
+                str += std::to_string(items[i]);
+                if (i + 1 != size) str += ",";
+            }
+            str += "\n};\n";
+            return str;
+        };
+        int bits[32];
+        for (int i = 0; i < 32; ++i) bits[i] = tables.shortHasArg[i];
+
+        std::string code = "// Prebuilt name indexes of the options, "
+                           "see miniopt.settables().\n";
+        code += genArray("int ShortIndex", tables.shortIndex, 256);
+        code += genArray("unsigned char ShortHasArg", bits, 32);
+        code += "static const option_tables Tables = {ShortIndex, "
+                "ShortHasArg, nil, 0, " +
+                std::to_string(tables.listed) + ",\n    {" +
+                std::to_string(tables.layout.shortSize) + ", " +
+                std::to_string(tables.layout.longSize) + ", " +
+                std::to_string(tables.layout.ahintSize) + ", " +
+                std::to_string(tables.layout.offset) + "}};";
+        miniopt_spec_release(spec.get());
+        return code;
     };
 
     code = config::code::CodeSample;
     code = searchAndReplace(code, config::code::TimeStamp, genTimeStamp());
     code = searchAndReplace(code, config::code::OptionList, genOptionList());
-    code = searchAndReplace(code, config::code::CaseList, genCaseList());
+    code = searchAndReplace(code, config::code::ArgList, genArgList());
+    code = searchAndReplace(code, config::code::LongNameLookup,
+                            genLongNameLookup());
+    code = searchAndReplace(code, config::code::HelpText, genHelpText());
+    code = searchAndReplace(code, config::code::Tables, genTables());
 
     return 0;
 }
@@ -520,12 +849,16 @@ int ParseArgs(int argc, char *argv[]) {
     std::string dir;
 
     option options[] = {{'o', "out", "<file>", "specify output file name "
-                                               "for the generated code."
+                                               "for the generated code.",
+                         MINIOPT_KIND_NONE, nil, nil
                         },
                         {'e', "export", "<dir>", "specify directory to export "
-                                                 "miniopt library files."},
-                        {'h', "help", nil, "show help."},
-                        {'v', "version", nil, "show version."}};
+                                                 "miniopt library files.",
+                         MINIOPT_KIND_NONE, nil, nil},
+                        {'h', "help", nil, "show help.",
+                         MINIOPT_KIND_NONE, nil, nil},
+                        {'v', "version", nil, "show version.",
+                         MINIOPT_KIND_NONE, nil, nil}};
     const int optsum = sizeof(options) / sizeof(options[0]);
 
     if (miniopt.init(argc, (char **)argv, options, optsum) != 0) {